@@ -0,0 +1,293 @@
+#include "blake3.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace blake3 {
+
+namespace {
+
+constexpr uint32_t IV[8] = {
+    0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+    0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19,
+};
+
+// Message word order for each of the 7 rounds (the permutation pre-applied).
+constexpr uint8_t MSG_SCHEDULE[7][16] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8},
+    {3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1},
+    {10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6},
+    {12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4},
+    {9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7},
+    {11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13},
+};
+
+constexpr uint32_t CHUNK_START = 1 << 0;
+constexpr uint32_t CHUNK_END = 1 << 1;
+constexpr uint32_t PARENT = 1 << 2;
+constexpr uint32_t ROOT = 1 << 3;
+
+// Subtrees handed to worker threads: 2^10 chunks = 1 MiB per task.
+constexpr unsigned SLICE_LOG2_CHUNKS = 10;
+constexpr size_t SLICE_LEN = CHUNK_LEN << SLICE_LOG2_CHUNKS;
+
+inline uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+inline void g(uint32_t s[16], int a, int b, int c, int d, uint32_t mx, uint32_t my) {
+    s[a] = s[a] + s[b] + mx;
+    s[d] = rotr(s[d] ^ s[a], 16);
+    s[c] = s[c] + s[d];
+    s[b] = rotr(s[b] ^ s[c], 12);
+    s[a] = s[a] + s[b] + my;
+    s[d] = rotr(s[d] ^ s[a], 8);
+    s[c] = s[c] + s[d];
+    s[b] = rotr(s[b] ^ s[c], 7);
+}
+
+inline void round_fn(uint32_t s[16], const uint32_t m[16], size_t r) {
+    const uint8_t* sc = MSG_SCHEDULE[r];
+    g(s, 0, 4, 8, 12, m[sc[0]], m[sc[1]]);
+    g(s, 1, 5, 9, 13, m[sc[2]], m[sc[3]]);
+    g(s, 2, 6, 10, 14, m[sc[4]], m[sc[5]]);
+    g(s, 3, 7, 11, 15, m[sc[6]], m[sc[7]]);
+    g(s, 0, 5, 10, 15, m[sc[8]], m[sc[9]]);
+    g(s, 1, 6, 11, 12, m[sc[10]], m[sc[11]]);
+    g(s, 2, 7, 8, 13, m[sc[12]], m[sc[13]]);
+    g(s, 3, 4, 9, 14, m[sc[14]], m[sc[15]]);
+}
+
+void compress(const uint32_t cv[8], const uint32_t block_words[16], uint64_t counter,
+              uint32_t block_len, uint32_t flags, uint32_t out[16]) {
+    uint32_t s[16] = {
+        cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+        IV[0], IV[1], IV[2], IV[3],
+        static_cast<uint32_t>(counter), static_cast<uint32_t>(counter >> 32),
+        block_len, flags,
+    };
+    for (size_t r = 0; r < 7; ++r) {
+        round_fn(s, block_words, r);
+    }
+    for (int i = 0; i < 8; ++i) {
+        out[i] = s[i] ^ s[i + 8];
+        out[i + 8] = s[i + 8] ^ cv[i];
+    }
+}
+
+inline void load_words(const uint8_t block[BLOCK_LEN], uint32_t words[16]) {
+    for (int i = 0; i < 16; ++i) {
+        words[i] = static_cast<uint32_t>(block[4 * i]) |
+                   (static_cast<uint32_t>(block[4 * i + 1]) << 8) |
+                   (static_cast<uint32_t>(block[4 * i + 2]) << 16) |
+                   (static_cast<uint32_t>(block[4 * i + 3]) << 24);
+    }
+}
+
+void parent_cv(const uint32_t left[8], const uint32_t right[8], uint32_t out_cv[8]) {
+    uint32_t words[16];
+    std::memcpy(words, left, 32);
+    std::memcpy(words + 8, right, 32);
+    uint32_t out[16];
+    compress(IV, words, 0, BLOCK_LEN, PARENT, out);
+    std::memcpy(out_cv, out, 32);
+}
+
+// Chaining value of one complete, non-root chunk.
+void chunk_cv(const uint8_t* chunk, uint64_t counter, uint32_t out_cv[8]) {
+    uint32_t cv[8];
+    std::memcpy(cv, IV, sizeof(cv));
+    size_t blocks = CHUNK_LEN / BLOCK_LEN;
+    for (size_t b = 0; b < blocks; ++b) {
+        uint32_t words[16];
+        load_words(chunk + b * BLOCK_LEN, words);
+        uint32_t flags = 0;
+        if (b == 0) flags |= CHUNK_START;
+        if (b + 1 == blocks) flags |= CHUNK_END;
+        uint32_t out[16];
+        compress(cv, words, counter, BLOCK_LEN, flags, out);
+        std::memcpy(cv, out, sizeof(cv));
+    }
+    std::memcpy(out_cv, cv, sizeof(cv));
+}
+
+std::string to_hex(const uint8_t* bytes, size_t n) {
+    static const char* digits = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(n * 2);
+    for (size_t i = 0; i < n; ++i) {
+        hex.push_back(digits[(bytes[i] >> 4) & 0xF]);
+        hex.push_back(digits[bytes[i] & 0xF]);
+    }
+    return hex;
+}
+
+} // namespace
+
+void subtree_cv(const uint8_t* input, size_t len, uint64_t chunk_counter,
+                unsigned log2_chunks, uint32_t out_cv[8]) {
+    size_t chunks = size_t(1) << log2_chunks;
+    (void)len;
+    std::vector<uint32_t> cvs(chunks * 8);
+    for (size_t i = 0; i < chunks; ++i) {
+        chunk_cv(input + i * CHUNK_LEN, chunk_counter + i, &cvs[i * 8]);
+    }
+    while (chunks > 1) {
+        for (size_t i = 0; i < chunks / 2; ++i) {
+            parent_cv(&cvs[2 * i * 8], &cvs[(2 * i + 1) * 8], &cvs[i * 8]);
+        }
+        chunks /= 2;
+    }
+    std::memcpy(out_cv, cvs.data(), 32);
+}
+
+Blake3Hasher::Blake3Hasher() : cv_stack_len_(0) {
+    reset_chunk(0);
+}
+
+void Blake3Hasher::reset_chunk(uint64_t counter) {
+    std::memcpy(chunk_.cv, IV, sizeof(chunk_.cv));
+    chunk_.chunk_counter = counter;
+    std::memset(chunk_.block, 0, sizeof(chunk_.block));
+    chunk_.block_len = 0;
+    chunk_.blocks_compressed = 0;
+}
+
+void Blake3Hasher::add_chunk_cv(uint32_t cv[8], uint64_t total_chunks) {
+    while ((total_chunks & 1) == 0) {
+        --cv_stack_len_;
+        parent_cv(cv_stack_[cv_stack_len_], cv, cv);
+        total_chunks >>= 1;
+    }
+    std::memcpy(cv_stack_[cv_stack_len_], cv, 32);
+    ++cv_stack_len_;
+}
+
+void Blake3Hasher::update(const void* data, size_t len) {
+    const uint8_t* in = static_cast<const uint8_t*>(data);
+    while (len > 0) {
+        size_t chunk_len = BLOCK_LEN * chunk_.blocks_compressed + chunk_.block_len;
+        if (chunk_len == CHUNK_LEN) {
+            uint32_t words[16];
+            load_words(chunk_.block, words);
+            uint32_t out[16];
+            compress(chunk_.cv, words, chunk_.chunk_counter, chunk_.block_len, CHUNK_END, out);
+            uint64_t total = chunk_.chunk_counter + 1;
+            add_chunk_cv(out, total);
+            reset_chunk(total);
+            continue;
+        }
+        if (chunk_.block_len == BLOCK_LEN) {
+            uint32_t words[16];
+            load_words(chunk_.block, words);
+            uint32_t flags = chunk_.blocks_compressed == 0 ? CHUNK_START : 0;
+            uint32_t out[16];
+            compress(chunk_.cv, words, chunk_.chunk_counter, BLOCK_LEN, flags, out);
+            std::memcpy(chunk_.cv, out, sizeof(chunk_.cv));
+            ++chunk_.blocks_compressed;
+            std::memset(chunk_.block, 0, sizeof(chunk_.block));
+            chunk_.block_len = 0;
+        }
+        size_t take = std::min(len, BLOCK_LEN - chunk_.block_len);
+        std::memcpy(chunk_.block + chunk_.block_len, in, take);
+        chunk_.block_len = static_cast<uint8_t>(chunk_.block_len + take);
+        in += take;
+        len -= take;
+    }
+}
+
+void Blake3Hasher::push_subtree(const uint32_t cv[8], unsigned log2_chunks) {
+    uint32_t tmp[8];
+    std::memcpy(tmp, cv, sizeof(tmp));
+    uint64_t total = chunk_.chunk_counter + (uint64_t(1) << log2_chunks);
+    add_chunk_cv(tmp, total >> log2_chunks);
+    reset_chunk(total);
+}
+
+void Blake3Hasher::finalize(uint8_t out[OUT_LEN]) const {
+    // Output node of the current (final) chunk.
+    uint32_t cv[8];
+    uint32_t words[16];
+    std::memcpy(cv, chunk_.cv, sizeof(cv));
+    load_words(chunk_.block, words);
+    uint64_t counter = chunk_.chunk_counter;
+    uint32_t block_len = chunk_.block_len;
+    uint32_t flags = CHUNK_END | (chunk_.blocks_compressed == 0 ? CHUNK_START : 0);
+
+    for (size_t i = cv_stack_len_; i > 0; --i) {
+        uint32_t o[16];
+        compress(cv, words, counter, block_len, flags, o);
+        std::memcpy(words, cv_stack_[i - 1], 32);
+        std::memcpy(words + 8, o, 32);
+        std::memcpy(cv, IV, sizeof(cv));
+        counter = 0;
+        block_len = BLOCK_LEN;
+        flags = PARENT;
+    }
+
+    uint32_t o[16];
+    compress(cv, words, counter, block_len, flags | ROOT, o);
+    for (size_t i = 0; i < OUT_LEN / 4; ++i) {
+        out[4 * i] = static_cast<uint8_t>(o[i]);
+        out[4 * i + 1] = static_cast<uint8_t>(o[i] >> 8);
+        out[4 * i + 2] = static_cast<uint8_t>(o[i] >> 16);
+        out[4 * i + 3] = static_cast<uint8_t>(o[i] >> 24);
+    }
+}
+
+std::string blake3_file(const std::string& path, size_t threads) {
+    std::error_code ec;
+    uint64_t size = std::filesystem::file_size(path, ec);
+    if (ec) return "";
+    std::ifstream tail(path, std::ios::binary);
+    if (!tail.is_open()) return "";
+
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+
+    // Every slice except the one holding the last byte can be hashed as an
+    // independent subtree; the tail goes through the incremental hasher so
+    // the root node is finalized correctly.
+    uint64_t slices = size == 0 ? 0 : (size - 1) / SLICE_LEN;
+    threads = static_cast<size_t>(std::min<uint64_t>(threads, slices));
+
+    Blake3Hasher hasher;
+    if (threads > 1) {
+        std::vector<uint32_t> cvs(slices * 8);
+        std::atomic<uint64_t> next{0};
+        std::atomic<bool> failed{false};
+        std::vector<std::thread> pool;
+        for (size_t t = 0; t < threads; ++t) {
+            pool.emplace_back([&]{
+                std::ifstream in(path, std::ios::binary);
+                if (!in.is_open()) { failed = true; return; }
+                std::vector<uint8_t> buf(SLICE_LEN);
+                for (uint64_t i = next++; i < slices && !failed; i = next++) {
+                    in.seekg(static_cast<std::streamoff>(i * SLICE_LEN));
+                    in.read(reinterpret_cast<char*>(buf.data()), SLICE_LEN);
+                    if (static_cast<size_t>(in.gcount()) != SLICE_LEN) { failed = true; return; }
+                    subtree_cv(buf.data(), SLICE_LEN, i << SLICE_LOG2_CHUNKS, SLICE_LOG2_CHUNKS, &cvs[i * 8]);
+                }
+            });
+        }
+        for (auto& t : pool) t.join();
+        if (failed) return "";
+        for (uint64_t i = 0; i < slices; ++i) {
+            hasher.push_subtree(&cvs[i * 8], SLICE_LOG2_CHUNKS);
+        }
+        tail.seekg(static_cast<std::streamoff>(slices * SLICE_LEN));
+    }
+
+    std::vector<char> buf(SLICE_LEN);
+    while (tail.read(buf.data(), buf.size()) || tail.gcount() > 0) {
+        hasher.update(buf.data(), static_cast<size_t>(tail.gcount()));
+    }
+
+    uint8_t out[OUT_LEN];
+    hasher.finalize(out);
+    return to_hex(out, OUT_LEN);
+}
+
+} // namespace blake3
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Portable BLAKE3 (unkeyed hash mode, 32-byte output).
+//
+// Blake3Hasher is the incremental hasher from the reference implementation,
+// extended with push_subtree() so that whole, aligned subtrees can be hashed
+// on other threads and merged in order. blake3_file() uses that to spread a
+// single file across all cores.
+namespace blake3 {
+
+constexpr size_t OUT_LEN = 32;
+constexpr size_t BLOCK_LEN = 64;
+constexpr size_t CHUNK_LEN = 1024;
+
+// Chaining value of a complete subtree of 2^log2_chunks chunks starting at
+// chunk index chunk_counter. len must equal CHUNK_LEN << log2_chunks.
+void subtree_cv(const uint8_t* input, size_t len, uint64_t chunk_counter,
+                unsigned log2_chunks, uint32_t out_cv[8]);
+
+class Blake3Hasher {
+public:
+    Blake3Hasher();
+
+    void update(const void* data, size_t len);
+
+    // Appends an already hashed subtree of 2^log2_chunks chunks. Must only be
+    // called on a chunk boundary aligned to the subtree size, and never for
+    // the final bytes of the input (the root node needs them).
+    void push_subtree(const uint32_t cv[8], unsigned log2_chunks);
+
+    void finalize(uint8_t out[OUT_LEN]) const;
+
+private:
+    struct ChunkState {
+        uint32_t cv[8];
+        uint64_t chunk_counter;
+        uint8_t block[BLOCK_LEN];
+        uint8_t block_len;
+        uint8_t blocks_compressed;
+    };
+
+    void reset_chunk(uint64_t counter);
+    void add_chunk_cv(uint32_t cv[8], uint64_t total_chunks);
+
+    ChunkState chunk_;
+    uint32_t cv_stack_[54][8];
+    uint8_t cv_stack_len_;
+};
+
+// Hashes a whole file, reading large slices on `threads` threads (0 = all
+// cores). Returns lowercase hex, or "" if the file cannot be read.
+std::string blake3_file(const std::string& path, size_t threads = 0);
+
+} // namespace blake3
@@ -0,0 +1,65 @@
+#include "hash.h"
+#include "blake3.h"
+#include <openssl/evp.h>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+namespace media {
+
+// Large reads keep the digest loop, not the syscall count, the bottleneck.
+static constexpr size_t READ_BUFFER = 1 << 20;
+
+const char* hash_algorithm_name(HashAlgorithm algo) {
+    switch (algo) {
+        case HashAlgorithm::Blake3: return "blake3";
+        case HashAlgorithm::Sha256:
+        default: return "sha256";
+    }
+}
+
+bool parse_hash_algorithm(const std::string& name, HashAlgorithm* out) {
+    if (name.empty() || name == "sha256") { *out = HashAlgorithm::Sha256; return true; }
+    if (name == "blake3") { *out = HashAlgorithm::Blake3; return true; }
+    return false;
+}
+
+static std::string sha256_evp_file(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return "";
+
+    std::unique_ptr<EVP_MD_CTX, decltype(&EVP_MD_CTX_free)> ctx(EVP_MD_CTX_new(), EVP_MD_CTX_free);
+    if (!ctx || EVP_DigestInit_ex(ctx.get(), EVP_sha256(), nullptr) != 1) return "";
+
+    std::vector<char> buffer(READ_BUFFER);
+    while (file.read(buffer.data(), buffer.size()) || file.gcount() > 0) {
+        if (EVP_DigestUpdate(ctx.get(), buffer.data(), static_cast<size_t>(file.gcount())) != 1) return "";
+    }
+
+    unsigned char hash[EVP_MAX_MD_SIZE];
+    unsigned int len = 0;
+    if (EVP_DigestFinal_ex(ctx.get(), hash, &len) != 1) return "";
+
+    static const char* digits = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(len * 2);
+    for (unsigned int i = 0; i < len; i++) {
+        hex.push_back(digits[(hash[i] >> 4) & 0xF]);
+        hex.push_back(digits[hash[i] & 0xF]);
+    }
+    return hex;
+}
+
+std::string hash_file(const std::string& path, HashAlgorithm algo, size_t threads) {
+    switch (algo) {
+        case HashAlgorithm::Blake3: return blake3::blake3_file(path, threads);
+        case HashAlgorithm::Sha256:
+        default: return sha256_evp_file(path);
+    }
+}
+
+std::string dedup_key(HashAlgorithm algo, const std::string& hex) {
+    return std::string(hash_algorithm_name(algo)) + ":" + hex;
+}
+
+} // namespace media
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// File hashing shared by the producer and the consumer.
+//
+// The algorithm travels with every upload (FileInfo.hash_algorithm) so two
+// digests are only ever compared when they were made the same way.
+namespace media {
+
+enum class HashAlgorithm {
+    Sha256,   // OpenSSL EVP; uses SHA-NI / ARMv8 crypto extensions when present
+    Blake3,   // tree hash, a single file is spread across all cores
+};
+
+const char* hash_algorithm_name(HashAlgorithm algo);
+
+// Accepts "sha256" or "blake3". An empty name means sha256, which is what
+// producers that predate the field always used.
+bool parse_hash_algorithm(const std::string& name, HashAlgorithm* out);
+
+// Lowercase hex digest of a file, or "" if it cannot be read. threads only
+// applies to Blake3 (0 = all cores).
+std::string hash_file(const std::string& path, HashAlgorithm algo = HashAlgorithm::Sha256, size_t threads = 0);
+
+// Duplicate detection key: "<algorithm>:<hex>".
+std::string dedup_key(HashAlgorithm algo, const std::string& hex);
+
+} // namespace media
@@ -0,0 +1,214 @@
+#include "common/trace.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#ifdef _WIN32
+#include <process.h>
+#define media_getpid _getpid
+#else
+#include <unistd.h>
+#define media_getpid getpid
+#endif
+
+namespace media {
+
+namespace {
+
+std::atomic<bool> g_enabled{false};
+
+// Owns the trace file. Events are buffered by the ofstream and flushed at
+// most once a second, on rotation and on shutdown.
+struct TraceWriter {
+    std::mutex mtx;
+    TraceConfig config;
+    std::ofstream out;
+    size_t bytes = 0;
+    int pid = 0;
+    uint64_t last_flush_us = 0;
+
+    void open() {
+        // Each run starts a new file; older ones shift to .1, .2, ...
+        std::error_code ec;
+        for (int i = config.max_files - 1; i >= 1; --i) {
+            std::string from = i == 1 ? config.path : config.path + "." + std::to_string(i - 1);
+            std::string to = config.path + "." + std::to_string(i);
+            if (std::filesystem::exists(from, ec)) std::filesystem::rename(from, to, ec);
+        }
+        out.open(config.path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "Cannot open trace file " << config.path << std::endl;
+            return;
+        }
+        std::string header = "[{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" + std::to_string(pid)
+                           + ",\"args\":{" + Tracer::arg("name", config.process_name) + "}}";
+        out << header;
+        bytes = header.size();
+    }
+
+    void close() {
+        if (!out.is_open()) return;
+        out << "\n]\n";
+        out.close();
+    }
+
+    void write(const std::string& event, uint64_t now) {
+        if (!out.is_open()) return;
+        out << ",\n" << event;
+        bytes += event.size() + 2;
+        if (bytes >= config.max_file_bytes) {
+            close();
+            open();
+        } else if (now - last_flush_us >= 1000000) {
+            out.flush();
+            last_flush_us = now;
+        }
+    }
+};
+
+TraceWriter& writer() {
+    static TraceWriter w;
+    return w;
+}
+
+std::mt19937_64& rng() {
+    thread_local std::mt19937_64 gen(std::random_device{}() ^ (static_cast<uint64_t>(std::random_device{}()) << 32));
+    return gen;
+}
+
+bool parse_hex(const std::string& s, size_t pos, size_t len, uint64_t* out) {
+    if (pos + len > s.size()) return false;
+    uint64_t v = 0;
+    for (size_t i = pos; i < pos + len; ++i) {
+        char c = s[i];
+        int d;
+        if (c >= '0' && c <= '9') d = c - '0';
+        else if (c >= 'a' && c <= 'f') d = c - 'a' + 10;
+        else return false;
+        v = (v << 4) | static_cast<uint64_t>(d);
+    }
+    *out = v;
+    return true;
+}
+
+std::string hex64(uint64_t v) {
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(v));
+    return buf;
+}
+
+} // namespace
+
+std::string TraceContext::trace_id() const {
+    return hex64(trace_hi) + hex64(trace_lo);
+}
+
+std::string TraceContext::traceparent() const {
+    return "00-" + trace_id() + "-" + hex64(span_id) + (sampled ? "-01" : "-00");
+}
+
+bool TraceContext::parse(const std::string& tp, TraceContext* out) {
+    // 00-<32 hex trace id>-<16 hex parent id>-<2 hex flags>
+    if (tp.size() < 55 || tp.compare(0, 3, "00-") != 0 || tp[35] != '-' || tp[52] != '-') return false;
+    TraceContext ctx;
+    uint64_t flags;
+    if (!parse_hex(tp, 3, 16, &ctx.trace_hi) || !parse_hex(tp, 19, 16, &ctx.trace_lo) ||
+        !parse_hex(tp, 36, 16, &ctx.span_id) || !parse_hex(tp, 53, 2, &flags)) {
+        return false;
+    }
+    if (!ctx.valid() || ctx.span_id == 0) return false;
+    ctx.sampled = (flags & 1) != 0;
+    *out = ctx;
+    return true;
+}
+
+void Tracer::init(const TraceConfig& config) {
+    if (config.path.empty()) return;
+    TraceWriter& w = writer();
+    std::lock_guard<std::mutex> lk(w.mtx);
+    w.config = config;
+    if (w.config.max_files < 1) w.config.max_files = 1;
+    w.pid = media_getpid();
+    w.open();
+    if (w.out.is_open()) {
+        g_enabled = true;
+        std::cout << "Tracing " << config.sample_rate * 100 << "% of uploads to " << config.path << std::endl;
+    }
+}
+
+void Tracer::shutdown() {
+    if (!g_enabled.exchange(false)) return;
+    TraceWriter& w = writer();
+    std::lock_guard<std::mutex> lk(w.mtx);
+    w.close();
+}
+
+bool Tracer::enabled() {
+    return g_enabled.load(std::memory_order_relaxed);
+}
+
+uint64_t Tracer::now_us() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+uint64_t Tracer::new_span_id() {
+    uint64_t id;
+    do { id = rng()(); } while (id == 0);
+    return id;
+}
+
+TraceContext Tracer::start_trace() {
+    TraceContext ctx;
+    if (!enabled()) return ctx;
+    do {
+        ctx.trace_hi = rng()();
+        ctx.trace_lo = rng()();
+    } while (!ctx.valid());
+    ctx.span_id = new_span_id();
+    double rate = writer().config.sample_rate;
+    ctx.sampled = rate >= 1.0 || std::uniform_real_distribution<double>(0.0, 1.0)(rng()) < rate;
+    return ctx;
+}
+
+TraceContext Tracer::continue_trace(const std::string& traceparent) {
+    if (!enabled()) return TraceContext();
+    TraceContext ctx;
+    // The upstream sampling decision wins so a trace is either whole or absent.
+    if (!traceparent.empty() && TraceContext::parse(traceparent, &ctx)) return ctx;
+    return start_trace();
+}
+
+std::string Tracer::arg(const char* key, const std::string& value) {
+    std::string out = "\"" + std::string(key) + "\":\"";
+    for (char c : value) {
+        if (c == '"' || c == '\\') { out += '\\'; out += c; }
+        else if (static_cast<unsigned char>(c) < 0x20) out += ' ';
+        else out += c;
+    }
+    return out + "\"";
+}
+
+void Tracer::record(const TraceContext& ctx, const char* name, uint64_t start_us, uint64_t dur_us,
+                    const std::string& args_json) {
+    if (!ctx.sampled || !enabled()) return;
+    TraceWriter& w = writer();
+    // One row per upload: spans of a trace never overlap except when nested.
+    unsigned tid = static_cast<unsigned>(ctx.trace_lo & 0x7fffffff);
+    std::string event = "{\"name\":\"" + std::string(name) + "\",\"cat\":\"upload\",\"ph\":\"X\""
+                      + ",\"ts\":" + std::to_string(start_us)
+                      + ",\"dur\":" + std::to_string(dur_us)
+                      + ",\"pid\":" + std::to_string(w.pid)
+                      + ",\"tid\":" + std::to_string(tid)
+                      + ",\"args\":{\"trace_id\":\"" + ctx.trace_id() + "\""
+                      + (args_json.empty() ? "" : "," + args_json) + "}}";
+    uint64_t now = start_us + dur_us;
+    std::lock_guard<std::mutex> lk(w.mtx);
+    w.write(event, now);
+}
+
+} // namespace media
@@ -0,0 +1,94 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Per-upload tracing shared by the producer and the consumer.
+//
+// A trace starts in the producer and travels to the consumer as a W3C
+// `traceparent` gRPC metadata entry, then inside UploadItem through the
+// worker stages. Every process writes its spans as Chrome Trace Event JSON
+// (chrome://tracing, ui.perfetto.dev) to its own rotating file; timestamps
+// are wall-clock microseconds, so producer and consumer files line up when
+// loaded together. Spans of one upload share a row (tid) derived from the
+// trace id.
+//
+// Tracing is off until Tracer::init() is called with a file. Unsampled
+// uploads carry a context with sampled == false, and every recording call
+// returns after testing that flag, without reading the clock.
+namespace media {
+
+struct TraceContext {
+    uint64_t trace_hi = 0;   // 128-bit trace id, 0/0 = none
+    uint64_t trace_lo = 0;
+    uint64_t span_id = 0;    // span that issued this context
+    bool sampled = false;
+
+    bool valid() const { return trace_hi != 0 || trace_lo != 0; }
+    std::string trace_id() const;           // 32 lowercase hex digits
+    std::string traceparent() const;        // "00-<trace id>-<span id>-<flags>"
+
+    // Accepts version 00 traceparent values; false if malformed.
+    static bool parse(const std::string& traceparent, TraceContext* out);
+};
+
+struct TraceConfig {
+    std::string path;                       // empty disables tracing
+    std::string process_name;               // row group label in the viewer
+    double sample_rate = 1.0;               // fraction of new traces recorded
+    size_t max_file_bytes = 64 * 1024 * 1024;
+    int max_files = 3;                      // path, path.1 .. path.<max_files-1>
+};
+
+class Tracer {
+public:
+    static void init(const TraceConfig& config);
+    // Flushes and closes the trace file.
+    static void shutdown();
+    static bool enabled();
+
+    // A new root context, sampled according to sample_rate. Not sampled
+    // (and not valid) when tracing is disabled.
+    static TraceContext start_trace();
+    // Continues a trace received from upstream; when the caller sent none,
+    // starts a new one. Not sampled when tracing is disabled here.
+    static TraceContext continue_trace(const std::string& traceparent);
+
+    static uint64_t now_us();
+    static uint64_t new_span_id();
+
+    // Writes one complete event. args_json is inserted into the event's args
+    // object as is (e.g. "\"file\":\"a.mp4\"").
+    static void record(const TraceContext& ctx, const char* name, uint64_t start_us, uint64_t dur_us,
+                       const std::string& args_json = "");
+
+    // "key":"value" with value escaped, for building args_json.
+    static std::string arg(const char* key, const std::string& value);
+};
+
+// Times a scope as one span of ctx. Does nothing for unsampled contexts.
+class Span {
+public:
+    Span(const TraceContext& ctx, const char* name)
+    : ctx_(ctx), name_(name), start_us_(ctx.sampled ? Tracer::now_us() : 0) {}
+    ~Span() { end(); }
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+
+    void set_args(std::string args_json) { if (ctx_.sampled) args_ = std::move(args_json); }
+    void end() {
+        if (!ctx_.sampled || ended_) return;
+        ended_ = true;
+        uint64_t now = Tracer::now_us();
+        Tracer::record(ctx_, name_, start_us_, now > start_us_ ? now - start_us_ : 0, args_);
+    }
+
+private:
+    TraceContext ctx_;
+    const char* name_;
+    uint64_t start_us_;
+    std::string args_;
+    bool ended_ = false;
+};
+
+} // namespace media
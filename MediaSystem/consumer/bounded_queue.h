@@ -9,24 +9,45 @@ class BoundedQueue {
 public:
     explicit BoundedQueue(size_t capacity): capacity_(capacity) {}
 
-    // Try to push; returns true if enqueued, false if dropped (full).
+    // Try to push; returns true if enqueued, false if dropped (full or closed).
     bool try_push(T&& item) {
         std::lock_guard<std::mutex> lk(mtx_);
-        if (q_.size() >= capacity_) return false;
+        if (closed_ || q_.size() >= capacity_) return false;
         q_.emplace_back(std::move(item));
-        cv_.notify_one();
+        not_empty_.notify_one();
         return true;
     }
 
-    // Blocks until item available.
-    T pop_blocking() {
+    // Blocks until there is room; returns false if the queue was closed.
+    bool push_blocking(T&& item) {
         std::unique_lock<std::mutex> lk(mtx_);
-        cv_.wait(lk, [&]{ return !q_.empty(); });
+        not_full_.wait(lk, [&]{ return closed_ || q_.size() < capacity_; });
+        if (closed_) return false;
+        q_.emplace_back(std::move(item));
+        not_empty_.notify_one();
+        return true;
+    }
+
+    // Blocks until item available. Returns nullopt once the queue is closed
+    // and everything pushed before close() has been handed out.
+    std::optional<T> pop_blocking() {
+        std::unique_lock<std::mutex> lk(mtx_);
+        not_empty_.wait(lk, [&]{ return closed_ || !q_.empty(); });
+        if (q_.empty()) return std::nullopt;
         T it = std::move(q_.front());
         q_.pop_front();
+        not_full_.notify_one();
         return it;
     }
 
+    // Rejects further pushes and wakes every waiter; queued items still drain.
+    void close() {
+        std::lock_guard<std::mutex> lk(mtx_);
+        closed_ = true;
+        not_empty_.notify_all();
+        not_full_.notify_all();
+    }
+
     size_t size() {
         std::lock_guard<std::mutex> lk(mtx_);
         return q_.size();
@@ -35,6 +56,8 @@ public:
 private:
     std::deque<T> q_;
     size_t capacity_;
+    bool closed_ = false;
     std::mutex mtx_;
-    std::condition_variable cv_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
 };
@@ -0,0 +1,272 @@
+#include "catalog.h"
+#include "object_store.h"
+#include <sqlite3.h>
+#include <filesystem>
+#include <iostream>
+
+namespace {
+
+struct Bind {
+    bool is_text;
+    std::string text;
+    int64_t num;
+};
+
+struct SortKey {
+    const char* name;
+    const char* column;
+    bool numeric;
+};
+
+const SortKey SORT_KEYS[] = {
+    {"uploaded", "uploaded_at", false},
+    {"duration", "duration_ms", true},
+    {"size", "filesize", true},
+    {"name", "filename", false},
+    {"height", "height", true},
+};
+
+std::string column_text(sqlite3_stmt* stmt, int col) {
+    const unsigned char* t = sqlite3_column_text(stmt, col);
+    return t ? reinterpret_cast<const char*>(t) : "";
+}
+
+} // namespace
+
+Catalog::Catalog(const std::string& db_path, bool read_only) {
+    int flags = read_only ? SQLITE_OPEN_READONLY : (SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE);
+    if (sqlite3_open_v2(db_path.c_str(), &db_, flags | SQLITE_OPEN_FULLMUTEX, nullptr) != SQLITE_OK) {
+        std::cerr << "Failed to open sqlite db: " << sqlite3_errmsg(db_) << std::endl;
+        sqlite3_close(db_);
+        db_ = nullptr;
+        return;
+    }
+    sqlite3_busy_timeout(db_, 5000);
+    if (!read_only) create_schema();
+}
+
+Catalog::~Catalog() {
+    if (db_) sqlite3_close(db_);
+}
+
+void Catalog::exec(const char* sql) {
+    char* err = nullptr;
+    sqlite3_exec(db_, sql, nullptr, nullptr, &err);
+    if (err) { std::cerr << "sqlite err: " << err << " in: " << sql << std::endl; sqlite3_free(err); }
+}
+
+// Databases created before a column existed get it added in place.
+void Catalog::ensure_column(const char* table, const char* column, const char* decl) {
+    std::string pragma = std::string("PRAGMA table_info(") + table + ");";
+    sqlite3_stmt* stmt = nullptr;
+    bool found = false;
+    if (sqlite3_prepare_v2(db_, pragma.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            if (column_text(stmt, 1) == column) found = true;
+        }
+        sqlite3_finalize(stmt);
+    }
+    if (found) return;
+    std::string alter = std::string("ALTER TABLE ") + table + " ADD COLUMN " + column + " " + decl + ";";
+    exec(alter.c_str());
+}
+
+void Catalog::create_schema() {
+    exec("PRAGMA journal_mode=WAL;");
+    exec("CREATE TABLE IF NOT EXISTS uploads (id INTEGER PRIMARY KEY, filename TEXT, checksum TEXT UNIQUE, path TEXT, preview TEXT, alias TEXT, hash_algorithm TEXT, uploaded_at DATETIME DEFAULT CURRENT_TIMESTAMP);");
+    ensure_column("uploads", "alias", "TEXT");
+    ensure_column("uploads", "hash_algorithm", "TEXT");
+
+    // Probe results. NOT NULL defaults keep keyset comparisons total.
+    ensure_column("uploads", "producer_id", "TEXT NOT NULL DEFAULT ''");
+    ensure_column("uploads", "filesize", "INTEGER NOT NULL DEFAULT 0");
+    ensure_column("uploads", "duration_ms", "INTEGER NOT NULL DEFAULT 0");
+    ensure_column("uploads", "container", "TEXT NOT NULL DEFAULT ''");
+    ensure_column("uploads", "video_codec", "TEXT NOT NULL DEFAULT ''");
+    ensure_column("uploads", "audio_codec", "TEXT NOT NULL DEFAULT ''");
+    ensure_column("uploads", "width", "INTEGER NOT NULL DEFAULT 0");
+    ensure_column("uploads", "height", "INTEGER NOT NULL DEFAULT 0");
+    ensure_column("uploads", "bitrate", "INTEGER NOT NULL DEFAULT 0");
+    ensure_column("uploads", "fps", "REAL NOT NULL DEFAULT 0");
+    ensure_column("uploads", "hls", "TEXT NOT NULL DEFAULT ''");
+
+    exec("CREATE INDEX IF NOT EXISTS idx_uploads_uploaded ON uploads(uploaded_at, id);");
+    exec("CREATE INDEX IF NOT EXISTS idx_uploads_producer ON uploads(producer_id, uploaded_at, id);");
+    exec("CREATE INDEX IF NOT EXISTS idx_uploads_vcodec ON uploads(video_codec, uploaded_at, id);");
+    exec("CREATE INDEX IF NOT EXISTS idx_uploads_duration ON uploads(duration_ms, id);");
+    exec("CREATE INDEX IF NOT EXISTS idx_uploads_height ON uploads(height, id);");
+    exec("CREATE INDEX IF NOT EXISTS idx_uploads_filename ON uploads(filename, id);");
+    exec("CREATE INDEX IF NOT EXISTS idx_uploads_filesize ON uploads(filesize, id);");
+
+    // The producer and codec filters are combined with every sort key, so
+    // each pair gets its own index and such a page is an index range walk
+    // instead of a scan of all matching rows plus a sort.
+    const char* const PAIR_FILTERS[][2] = {{"producer", "producer_id"}, {"vcodec", "video_codec"}};
+    for (const auto& f : PAIR_FILTERS) {
+        for (const auto& k : SORT_KEYS) {
+            if (std::string(k.name) == "uploaded") continue;   // idx_uploads_producer / _vcodec
+            std::string sql = std::string("CREATE INDEX IF NOT EXISTS idx_uploads_") + f[0] + "_" + k.name
+                            + " ON uploads(" + f[1] + ", " + k.column + ", id);";
+            exec(sql.c_str());
+        }
+    }
+}
+
+void Catalog::insert(const UploadItem& item) {
+    if (!db_) return;
+    const char* insert_sql =
+        "INSERT OR IGNORE INTO uploads(filename, checksum, path, preview, alias, hash_algorithm, producer_id, filesize,"
+        " duration_ms, container, video_codec, audio_codec, width, height, bitrate, fps, hls)"
+        " VALUES(?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?);";
+    std::lock_guard<std::mutex> lk(mtx_);
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db_, insert_sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        std::cerr << "sqlite prepare err: " << sqlite3_errmsg(db_) << std::endl;
+        return;
+    }
+    const MediaInfo& m = item.media;
+    sqlite3_bind_text(stmt, 1, item.filename.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, item.checksum.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 3, item.stored_path.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 4, item.preview_path.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 5, item.alias.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 6, item.hash_algorithm.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 7, item.producer_id.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, 8, item.filesize);
+    sqlite3_bind_int64(stmt, 9, m.duration_ms);
+    sqlite3_bind_text(stmt, 10, m.container.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 11, m.video_codec.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 12, m.audio_codec.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt, 13, m.width);
+    sqlite3_bind_int(stmt, 14, m.height);
+    sqlite3_bind_int64(stmt, 15, m.bitrate);
+    sqlite3_bind_double(stmt, 16, m.fps);
+    sqlite3_bind_text(stmt, 17, item.hls_playlist.c_str(), -1, SQLITE_TRANSIENT);
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        std::cerr << "sqlite insert err: " << sqlite3_errmsg(db_) << std::endl;
+    }
+    sqlite3_finalize(stmt);
+}
+
+bool Catalog::search(const CatalogQuery& q, CatalogPage* page, std::string* err) {
+    if (!db_) { *err = "catalog unavailable"; return false; }
+
+    const SortKey* sort = nullptr;
+    for (const auto& k : SORT_KEYS) {
+        if (q.sort == k.name) sort = &k;
+    }
+    if (!sort) { *err = "unknown sort: " + q.sort; return false; }
+
+    std::string sql =
+        "SELECT id, filename, producer_id, checksum, hash_algorithm, alias, preview, uploaded_at, filesize,"
+        " duration_ms, container, video_codec, audio_codec, width, height, bitrate, fps, hls"
+        " FROM uploads WHERE 1=1";
+    std::vector<Bind> binds;
+    auto text_eq = [&](const char* col, const std::string& v) {
+        if (v.empty()) return;
+        sql += std::string(" AND ") + col + " = ?";
+        binds.push_back({true, v, 0});
+    };
+    auto num_cmp = [&](const char* col, const char* op, int64_t v) {
+        if (v < 0) return;
+        sql += std::string(" AND ") + col + " " + op + " ?";
+        binds.push_back({false, "", v});
+    };
+
+    text_eq("producer_id", q.producer);
+    text_eq("video_codec", q.video_codec);
+    text_eq("audio_codec", q.audio_codec);
+    text_eq("container", q.container);
+    if (!q.name_prefix.empty()) {
+        // Range instead of LIKE so the filename index applies.
+        sql += " AND filename >= ? AND filename < ?";
+        binds.push_back({true, q.name_prefix, 0});
+        binds.push_back({true, q.name_prefix + "\xff", 0});
+    }
+    if (!q.from.empty()) { sql += " AND uploaded_at >= ?"; binds.push_back({true, q.from, 0}); }
+    if (!q.to.empty()) { sql += " AND uploaded_at < ?"; binds.push_back({true, q.to, 0}); }
+    num_cmp("duration_ms", ">=", q.min_duration_ms);
+    num_cmp("duration_ms", "<=", q.max_duration_ms);
+    num_cmp("height", ">=", q.min_height);
+    num_cmp("height", "<=", q.max_height);
+
+    if (!q.cursor.empty()) {
+        size_t sep = q.cursor.rfind(':');
+        if (sep == std::string::npos) { *err = "bad cursor"; return false; }
+        std::string value = q.cursor.substr(0, sep);
+        int64_t id;
+        try { id = std::stoll(q.cursor.substr(sep + 1)); } catch (...) { *err = "bad cursor"; return false; }
+        sql += std::string(" AND (") + sort->column + ", id) " + (q.descending ? "<" : ">") + " (?, ?)";
+        if (sort->numeric) {
+            try { binds.push_back({false, "", std::stoll(value)}); } catch (...) { *err = "bad cursor"; return false; }
+        } else {
+            binds.push_back({true, value, 0});
+        }
+        binds.push_back({false, "", id});
+    }
+
+    const char* dir = q.descending ? " DESC" : " ASC";
+    sql += std::string(" ORDER BY ") + sort->column + dir + ", id" + dir + " LIMIT ?";
+    size_t limit = q.limit == 0 ? 1 : (q.limit > 500 ? 500 : q.limit);
+    binds.push_back({false, "", static_cast<int64_t>(limit + 1)});
+
+    std::lock_guard<std::mutex> lk(mtx_);
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db_, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        *err = sqlite3_errmsg(db_);
+        return false;
+    }
+    for (size_t i = 0; i < binds.size(); ++i) {
+        int idx = static_cast<int>(i + 1);
+        if (binds[i].is_text) sqlite3_bind_text(stmt, idx, binds[i].text.c_str(), -1, SQLITE_TRANSIENT);
+        else sqlite3_bind_int64(stmt, idx, binds[i].num);
+    }
+
+    page->rows.clear();
+    page->next_cursor.clear();
+    std::string last_sort_value;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (page->rows.size() == limit) {
+            const CatalogRow& last = page->rows.back();
+            page->next_cursor = last_sort_value + ":" + std::to_string(last.id);
+            break;
+        }
+        CatalogRow r;
+        r.id = sqlite3_column_int64(stmt, 0);
+        r.filename = column_text(stmt, 1);
+        r.producer_id = column_text(stmt, 2);
+        r.checksum = column_text(stmt, 3);
+        r.hash_algorithm = column_text(stmt, 4);
+        std::string alias = column_text(stmt, 5);
+        std::string preview = column_text(stmt, 6);
+        r.uploaded_at = column_text(stmt, 7);
+        r.filesize = sqlite3_column_int64(stmt, 8);
+        r.media.duration_ms = sqlite3_column_int64(stmt, 9);
+        r.media.container = column_text(stmt, 10);
+        r.media.video_codec = column_text(stmt, 11);
+        r.media.audio_codec = column_text(stmt, 12);
+        r.media.width = sqlite3_column_int(stmt, 13);
+        r.media.height = sqlite3_column_int(stmt, 14);
+        r.media.bitrate = sqlite3_column_int64(stmt, 15);
+        r.media.fps = sqlite3_column_double(stmt, 16);
+        std::string hls = column_text(stmt, 17);
+
+        r.url = alias.empty()
+            ? "/uploads/" + ObjectStore::object_url_path(r.checksum)
+            : "/uploads/names/" + alias;
+        if (!preview.empty()) r.preview_url = "/previews/" + std::filesystem::path(preview).filename().string();
+        if (!hls.empty()) r.hls_url = "/hls/" + r.checksum + "/index.m3u8";
+
+        if (sort->numeric) {
+            int col = q.sort == "duration" ? 9 : q.sort == "size" ? 8 : 14;
+            last_sort_value = std::to_string(sqlite3_column_int64(stmt, col));
+        } else {
+            last_sort_value = q.sort == "name" ? r.filename : r.uploaded_at;
+        }
+        page->rows.push_back(std::move(r));
+    }
+    if (rc != SQLITE_ROW && rc != SQLITE_DONE) *err = sqlite3_errmsg(db_);
+    sqlite3_finalize(stmt);
+    return rc == SQLITE_ROW || rc == SQLITE_DONE;
+}
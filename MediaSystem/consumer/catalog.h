@@ -0,0 +1,79 @@
+#pragma once
+#include "worker.h"
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct sqlite3;
+
+// Filters, ordering and page position for Catalog::search. Empty strings and
+// negative numbers mean "no filter".
+struct CatalogQuery {
+    std::string producer;
+    std::string video_codec;
+    std::string audio_codec;
+    std::string container;
+    std::string name_prefix;
+    std::string from;             // uploaded_at >= from ("YYYY-MM-DD[ HH:MM:SS]")
+    std::string to;               // uploaded_at <  to
+    int64_t min_duration_ms = -1;
+    int64_t max_duration_ms = -1;
+    int min_height = -1;
+    int max_height = -1;
+    std::string sort = "uploaded";  // uploaded | duration | size | name | height
+    bool descending = true;
+    size_t limit = 50;
+    std::string cursor;           // next_cursor of the previous page
+};
+
+struct CatalogRow {
+    int64_t id = 0;
+    std::string filename;
+    std::string producer_id;
+    std::string checksum;
+    std::string hash_algorithm;
+    std::string url;
+    std::string preview_url;
+    std::string hls_url;          // empty if the upload was not packaged
+    std::string uploaded_at;
+    int64_t filesize = 0;
+    MediaInfo media;
+};
+
+struct CatalogPage {
+    std::vector<CatalogRow> rows;
+    std::string next_cursor;      // empty on the last page
+};
+
+// SQLite catalog of stored uploads (<storage>/metadata.db).
+//
+// Pages are addressed by keyset (the last row's sort value and id) rather
+// than OFFSET. Every sort key has an index ending in id, alone and behind a
+// producer or video codec filter, so with at most one of those two filters
+// a page is an index range walk whose cost does not depend on its position
+// or on the catalog size. Further filters are not covered: SQLite either
+// checks them row by row along that walk or, for a range on another column
+// (e.g. codec + min height sorted by upload time), reads the range from its
+// index and sorts the matches. Either way such a page costs in proportion
+// to the rows the extra filter rejects or matches, not to the page size.
+class Catalog {
+public:
+    // The writer creates and migrates the schema and switches the database
+    // to WAL so read-only connections never block it.
+    Catalog(const std::string& db_path, bool read_only);
+    ~Catalog();
+
+    bool ok() const { return db_ != nullptr; }
+
+    void insert(const UploadItem& item);
+    bool search(const CatalogQuery& query, CatalogPage* page, std::string* err);
+
+private:
+    void create_schema();
+    void ensure_column(const char* table, const char* column, const char* decl);
+    void exec(const char* sql);
+
+    sqlite3* db_ = nullptr;
+    std::mutex mtx_;
+};
@@ -4,31 +4,143 @@
 #include <thread>
 #include <grpcpp/grpcpp.h>
 #include "grpc_service.h"
+#include "catalog.h"
+#include "static_assets.h"
+#include "segment_cache.h"
+#include "common/trace.h"
 #include "httplib.h"
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstdio>
+
+static std::atomic<bool> g_shutdown_requested{false};
+
+static void on_shutdown_signal(int) {
+    g_shutdown_requested = true;
+}
+
+static std::string json_escape(const std::string& in) {
+    std::string out;
+    out.reserve(in.size());
+    for (char c : in) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    return out;
+}
+
+static std::string catalog_row_json(const CatalogRow& r) {
+    const MediaInfo& m = r.media;
+    return "{\"id\":" + std::to_string(r.id)
+         + ",\"filename\":\"" + json_escape(r.filename) + "\""
+         + ",\"producer_id\":\"" + json_escape(r.producer_id) + "\""
+         + ",\"checksum\":\"" + r.checksum + "\""
+         + ",\"hash_algorithm\":\"" + r.hash_algorithm + "\""
+         + ",\"url\":\"" + json_escape(r.url) + "\""
+         + ",\"preview\":\"" + json_escape(r.preview_url) + "\""
+         + ",\"hls\":\"" + json_escape(r.hls_url) + "\""
+         + ",\"uploaded_at\":\"" + r.uploaded_at + "\""
+         + ",\"filesize\":" + std::to_string(r.filesize)
+         + ",\"container\":\"" + json_escape(m.container) + "\""
+         + ",\"video_codec\":\"" + json_escape(m.video_codec) + "\""
+         + ",\"audio_codec\":\"" + json_escape(m.audio_codec) + "\""
+         + ",\"duration_ms\":" + std::to_string(m.duration_ms)
+         + ",\"bitrate\":" + std::to_string(m.bitrate)
+         + ",\"width\":" + std::to_string(m.width)
+         + ",\"height\":" + std::to_string(m.height)
+         + ",\"fps\":" + std::to_string(m.fps) + "}";
+}
+
+static void print_usage() {
+    std::cerr << "Usage: consumer [--workers N] [--io-workers N] [--queue N] [--stage-queue N] [--web-dir DIR] [--dev] [--hls] [--package-workers N]\n"
+              << "                [--hls-cache-mb N] [--trace FILE] [--trace-sample RATE] [--trace-max-mb N]\n"
+              << "  --workers N      preview (ffmpeg) threads, default one per core minus the package threads\n"
+              << "  --io-workers N   finalize/probe threads, default 2\n"
+              << "  --queue N        uploads waiting to be finalized before producers get \"queue full\", default 8\n"
+              << "  --stage-queue N  hand-off queue size between later stages, default 8\n"
+              << "  --web-dir DIR    folder with index.html and main.js, default: first of ../../../web, ../../web, ../web, ./web\n"
+              << "  --dev            reload web files when they change and disable browser caching\n"
+              << "  --hls            package uploads as HLS (fMP4 segments) and play them through /hls\n"
+              << "  --package-workers N  HLS packaging (ffmpeg) threads with --hls, default 1\n"
+              << "  --hls-cache-mb N memory for cached HLS segments, default 256\n"
+              << "  --trace FILE     write per-upload spans (Chrome trace JSON) to FILE, rotated as FILE.1, FILE.2\n"
+              << "  --trace-sample R fraction of uploads without a producer trace to record, default 1\n"
+              << "  --trace-max-mb N rotate the trace file after N MB, default 64" << std::endl;
+}
 
 int main(int argc, char** argv) {
-    size_t queue_capacity = 8;
+    WorkerConfig workers;
+    std::string web_dir;
+    bool dev_mode = false;
+    bool hls = false;
+    size_t hls_cache_mb = 256;
+    media::TraceConfig trace;
+    trace.process_name = "consumer";
+    for (int i = 1; i < argc; ++i) {
+        std::string flag = argv[i];
+        if (flag == "--dev") { dev_mode = true; continue; }
+        if (flag == "--hls") { hls = true; continue; }
+        if (i + 1 >= argc) { print_usage(); return 1; }
+        if (flag == "--web-dir") { web_dir = argv[++i]; continue; }
+        if (flag == "--trace") { trace.path = argv[++i]; continue; }
+        if (flag == "--trace-sample") { trace.sample_rate = std::strtod(argv[++i], nullptr); continue; }
+        size_t value = std::strtoul(argv[++i], nullptr, 10);
+        if (flag == "--workers") workers.cpu_workers = value;
+        else if (flag == "--io-workers") workers.io_workers = value;
+        else if (flag == "--queue") workers.queue_capacity = value;
+        else if (flag == "--stage-queue") workers.stage_capacity = value;
+        else if (flag == "--package-workers") workers.package_workers = value;
+        else if (flag == "--hls-cache-mb") hls_cache_mb = value;
+        else if (flag == "--trace-max-mb") trace.max_file_bytes = value * 1024 * 1024;
+        else { print_usage(); return 1; }
+    }
+
+    auto rpc_grace = std::chrono::seconds(10);
+    auto drain_timeout = std::chrono::seconds(30);
     std::string storage_dir = "./uploads";
     std::string preview_dir = "./previews";
+    std::string hls_dir = "./hls";
     int http_port = 8080;
     int grpc_port = 50051;
 
     std::filesystem::create_directories(storage_dir);
     std::filesystem::create_directories(preview_dir);
+    if (hls) workers.hls_dir = hls_dir;
+    media::Tracer::init(trace);
 
     auto notify = [&](const UploadItem& item, const std::string& preview_url, const std::string& final_url){
         std::string meta = storage_dir + "/.uploads.jsonl";
         std::ofstream ofs(meta, std::ios::app);
-        ofs << "{ \"filename\":\"" << item.filename << "\", \"preview\":\"" << preview_url << "\", \"url\":\"" << final_url << "\" }\n";
+        ofs << "{ \"filename\":\"" << item.filename << "\", \"preview\":\"" << preview_url << "\", \"url\":\"" << final_url << "\"";
+        if (!item.hls_playlist.empty()) ofs << ", \"hls\":\"/hls/" << item.checksum << "/index.m3u8\"";
+        ofs << " }\n";
     };
 
-    MediaUploadServiceImpl service(queue_capacity, storage_dir, preview_dir, notify);
+    MediaUploadServiceImpl service(workers, storage_dir, preview_dir, notify);
 
     service.start_workers();
 
+    // Separate read-only connection: searches never wait on the catalog writer.
+    Catalog catalog(storage_dir + "/metadata.db", true);
+
     std::string server_address = "0.0.0.0:" + std::to_string(grpc_port);
     grpc::ServerBuilder builder;
     builder.AddListeningPort(server_address, grpc::InsecureServerCredentials());
@@ -38,29 +150,27 @@ int main(int argc, char** argv) {
 
     httplib::Server svr;
     
-    svr.Get("/", [](const httplib::Request&, httplib::Response& res){
-        std::ifstream ifs("../../../web/index.html");
-        if (!ifs.is_open()) {
+    // index.html is revalidated on every load so UI changes show up at once;
+    // the ETag turns that into a 304 without a body.
+    StaticAssets assets(StaticAssets::find_web_dir(web_dir), dev_mode);
+    assets.add("/", "index.html", "text/html; charset=utf-8", "no-cache");
+    assets.add("/main.js", "main.js", "application/javascript", "public, max-age=3600");
+
+    svr.Get("/", [&assets](const httplib::Request& req, httplib::Response& res){
+        if (!assets.serve("/", req, res)) {
             res.status = 404;
             res.set_content("index.html not found", "text/plain");
-            return;
         }
-        std::stringstream ss; ss << ifs.rdbuf();
-        res.set_content(ss.str(), "text/html");
     });
 
-    svr.Get("/main.js", [](const httplib::Request&, httplib::Response& res){
-        std::ifstream ifs("../../../web/main.js");
-        if (!ifs.is_open()) {
+    svr.Get("/main.js", [&assets](const httplib::Request& req, httplib::Response& res){
+        if (!assets.serve("/main.js", req, res)) {
             res.status = 404;
             res.set_content("main.js not found", "text/plain");
-            return;
         }
-        std::stringstream ss; ss << ifs.rdbuf();
-        res.set_content(ss.str(), "application/javascript");
     });
     
-    svr.Get("/api/list", [&storage_dir](const httplib::Request&, httplib::Response& res){
+    svr.Get("/api/list", [&storage_dir](const httplib::Request& req, httplib::Response& res){
         std::string meta = storage_dir + "/.uploads.jsonl";
         std::ifstream ifs(meta);
         std::string line;
@@ -74,15 +184,76 @@ int main(int argc, char** argv) {
             if (i+1<rows.size()) out += ",";
         }
         out += "]";
-        res.set_content(out, "application/json");
+        set_compressed_content(req, res, out, "application/json");
     });
     
-    svr.Get("/api/stats", [&service](const httplib::Request&, httplib::Response& res){
-        std::string json = "{\"duplicates\":" + std::to_string(service.get_duplicate_count()) + "}";
-        res.set_content(json, "application/json");
+    SegmentCache segments(hls_cache_mb * 1024 * 1024);
+
+    svr.Get("/api/stats", [&service, &segments](const httplib::Request& req, httplib::Response& res){
+        std::string json = "{\"duplicates\":" + std::to_string(service.get_duplicate_count()) + ",\"stages\":[";
+        auto stages = service.get_stage_stats();
+        for (size_t i = 0; i < stages.size(); ++i) {
+            const auto& st = stages[i];
+            json += "{\"name\":\"" + st.name + "\""
+                  + ",\"workers\":" + std::to_string(st.workers)
+                  + ",\"queue_depth\":" + std::to_string(st.queue_depth)
+                  + ",\"busy\":" + std::to_string(st.busy)
+                  + ",\"processed\":" + std::to_string(st.processed)
+                  + ",\"avg_service_ms\":" + std::to_string(st.avg_service_ms) + "}";
+            if (i + 1 < stages.size()) json += ",";
+        }
+        auto cache = segments.stats();
+        json += "],\"hls_cache\":{\"hits\":" + std::to_string(cache.hits)
+              + ",\"misses\":" + std::to_string(cache.misses)
+              + ",\"entries\":" + std::to_string(cache.entries)
+              + ",\"bytes\":" + std::to_string(cache.bytes) + "}}";
+        set_compressed_content(req, res, json, "application/json");
     });
 
-    svr.Post("/api/compress", [&storage_dir](const httplib::Request& req, httplib::Response& res){
+    // /api/search?producer=&codec=&audio_codec=&container=&name=&from=&to=
+    //   &min_duration=&max_duration=&min_height=&max_height=
+    //   &sort=uploaded|duration|size|name|height&order=asc|desc&limit=&cursor=
+    svr.Get("/api/search", [&catalog](const httplib::Request& req, httplib::Response& res){
+        auto param = [&req](const char* key) { return req.get_param_value(key); };
+        auto number = [&req](const char* key, int64_t fallback) {
+            return req.has_param(key) ? std::strtoll(req.get_param_value(key).c_str(), nullptr, 10) : fallback;
+        };
+        CatalogQuery q;
+        q.producer = param("producer");
+        q.video_codec = param("codec");
+        q.audio_codec = param("audio_codec");
+        q.container = param("container");
+        q.name_prefix = param("name");
+        q.from = param("from");
+        q.to = param("to");
+        q.min_duration_ms = number("min_duration", -1);
+        q.max_duration_ms = number("max_duration", -1);
+        q.min_height = static_cast<int>(number("min_height", -1));
+        q.max_height = static_cast<int>(number("max_height", -1));
+        if (req.has_param("sort")) q.sort = param("sort");
+        q.descending = param("order") != "asc";
+        q.limit = static_cast<size_t>(number("limit", 50));
+        q.cursor = param("cursor");
+
+        CatalogPage page;
+        std::string err;
+        if (!catalog.search(q, &page, &err)) {
+            res.status = 400;
+            res.set_content("{\"error\":\"" + json_escape(err) + "\"}", "application/json");
+            return;
+        }
+        std::string json = "{\"items\":[";
+        for (size_t i = 0; i < page.rows.size(); ++i) {
+            json += catalog_row_json(page.rows[i]);
+            if (i + 1 < page.rows.size()) json += ",";
+        }
+        json += "],\"next_cursor\":";
+        json += page.next_cursor.empty() ? "null" : "\"" + json_escape(page.next_cursor) + "\"";
+        json += "}";
+        set_compressed_content(req, res, json, "application/json");
+    });
+
+    svr.Post("/api/compress", [&service](const httplib::Request& req, httplib::Response& res){
         std::string body = req.body;
         size_t pos = body.find("\"filename\":\"");
         if (pos == std::string::npos) {
@@ -93,13 +264,13 @@ int main(int argc, char** argv) {
         size_t end = body.find("\"", pos);
         std::string filename = body.substr(pos, end - pos);
         
-        std::string original_path = storage_dir + "/" + filename;
+        std::string original_path = service.store().alias_path(filename);
         if (!std::filesystem::exists(original_path)) {
             res.set_content("{\"success\":false,\"message\":\"file not found\"}", "application/json");
             return;
         }
         
-        std::string compressed_path = storage_dir + "/compressed_" + filename;
+        std::string compressed_path = service.store().alias_path("compressed_" + ObjectStore::sanitize_filename(filename));
         std::string cmd = "ffmpeg -y -hide_banner -loglevel error -i \"" + original_path + "\" -c:v libx264 -preset medium -crf 23 -c:a aac -b:a 128k \"" + compressed_path + "\"";
         
         int rc = std::system(cmd.c_str());
@@ -122,6 +293,30 @@ int main(int argc, char** argv) {
         }
     });
 
+    // Packaged uploads live under their checksum and are never rewritten, so
+    // segments are cached for good; playlists get a short max-age anyway so
+    // a re-packaged upload is picked up by players eventually.
+    svr.Get(R"(/hls/([0-9a-f]+)/([A-Za-z0-9_]+)\.(m3u8|m4s|mp4))", [&hls_dir, &segments](const httplib::Request& req, httplib::Response& res){
+        std::string ext = req.matches[3];
+        std::string path = hls_dir + "/" + req.matches[1].str() + "/" + req.matches[2].str() + "." + ext;
+        auto data = segments.get(path);
+        if (!data) {
+            res.status = 404;
+            res.set_content("not found", "text/plain");
+            return;
+        }
+        if (ext == "m3u8") {
+            res.set_header("Cache-Control", "public, max-age=60");
+            set_compressed_content(req, res, *data, "application/vnd.apple.mpegurl");
+            return;
+        }
+        res.set_header("Cache-Control", "public, max-age=31536000, immutable");
+        res.set_content_provider(data->size(), ext == "m4s" ? "video/iso.segment" : "video/mp4",
+            [data](size_t offset, size_t length, httplib::DataSink& sink) {
+                return sink.write(data->data() + offset, length);
+            });
+    });
+
     svr.set_mount_point("/uploads", storage_dir.c_str());
     svr.set_mount_point("/previews", preview_dir.c_str());
 
@@ -130,8 +325,33 @@ int main(int argc, char** argv) {
         svr.listen("0.0.0.0", http_port);
     });
 
+    // SIGTERM / Ctrl+C: stop accepting uploads, let in-flight RPCs finish,
+    // then drain the work queues for a bounded time. Anything left over is
+    // journaled and replayed on the next start.
+    std::signal(SIGINT, on_shutdown_signal);
+    std::signal(SIGTERM, on_shutdown_signal);
+    std::thread shutdown_watcher([&](){
+        while (!g_shutdown_requested) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        std::cout << "Shutting down: finishing in-flight uploads" << std::endl;
+        server->Shutdown(std::chrono::system_clock::now() + rpc_grace);
+    });
+
     server->Wait();
+    std::cout << "Draining work queues (up to " << drain_timeout.count() << "s)" << std::endl;
+    if (!service.stop_workers(drain_timeout)) {
+        // Detached workers still use the service, its journal and store, and
+        // notify's captures. Unwinding main would free them underneath, so
+        // leave without running destructors; the synced journal replays
+        // whatever they had not finished on the next start.
+        media::Tracer::shutdown();
+        std::cout << "Exiting with unfinished work journaled" << std::endl;
+        std::_Exit(EXIT_FAILURE);
+    }
+    media::Tracer::shutdown();
     svr.stop();
     http.join();
+    shutdown_watcher.join();
     return 0;
 }
\ No newline at end of file
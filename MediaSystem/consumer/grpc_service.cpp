@@ -1,20 +1,49 @@
 #include "grpc_service.h"
-#include "sha256.h"
+#include "common/hash.h"
+#include "common/trace.h"
 #include <fstream>
 #include <iostream>
 #include <filesystem>
-#include "bounded_queue.h"
 #include "worker.h"
 #include "media.grpc.pb.h"
 
-MediaUploadServiceImpl::MediaUploadServiceImpl(size_t queue_capacity,
+MediaUploadServiceImpl::MediaUploadServiceImpl(const WorkerConfig& workers,
                                                const std::string& storage_dir,
                                                const std::string& preview_dir,
                                                std::function<void(const UploadItem&, const std::string&, const std::string&)> notify)
-: queue_(queue_capacity), queue_capacity_(queue_capacity), storage_dir_(storage_dir), preview_dir_(preview_dir), notify_(notify) {
-    pool_ = new WorkerPool(std::thread::hardware_concurrency(), storage_dir_, preview_dir_, notify_);
+: storage_dir_(storage_dir), preview_dir_(preview_dir), store_(storage_dir),
+  journal_(storage_dir + "/.journal"), notify_(notify) {
+    pool_ = new WorkerPool(workers, store_, preview_dir_, notify_,
+                           [this](const UploadItem& item){ journal_.mark_done(item.temp_path); });
     checksums_file_ = storage_dir_ + "/.checksums.txt";
     load_checksums();
+    recover_journal();
+}
+
+void MediaUploadServiceImpl::recover_journal() {
+    recovered_ = journal_.recover(store_);
+
+    // Staged files not referenced by the journal are uploads that never got
+    // an "enqueued" reply (the producer will retry them) or leftovers from a
+    // cross-device copy; either way nothing will ever pick them up.
+    std::unordered_set<std::string> keep;
+    for (auto& item : recovered_) {
+        keep.insert(std::filesystem::path(item.temp_path).lexically_normal().string());
+
+        media::HashAlgorithm algo;
+        if (!media::parse_hash_algorithm(item.hash_algorithm, &algo)) algo = media::HashAlgorithm::Sha256;
+        std::string key = media::dedup_key(algo, item.checksum);
+        if (checksums_.insert(key).second) save_checksum(key);
+    }
+    size_t orphans = 0;
+    std::error_code ec;
+    for (auto& p : std::filesystem::directory_iterator(store_.staging_dir(), ec)) {
+        if (keep.count(p.path().lexically_normal().string())) continue;
+        std::filesystem::remove(p.path(), ec);
+        ++orphans;
+    }
+    std::cout << "Journal: " << recovered_.size() << " unfinished uploads to replay, "
+              << orphans << " orphaned staging files removed" << std::endl;
 }
 
 void MediaUploadServiceImpl::load_checksums() {
@@ -26,29 +55,46 @@ void MediaUploadServiceImpl::load_checksums() {
     
     std::string line;
     while (std::getline(ifs, line)) {
-        if (!line.empty()) {
-            checksums_.insert(line);
+        if (line.empty()) continue;
+        // Entries written before hash algorithms were declared are bare SHA-256.
+        if (line.find(':') == std::string::npos) {
+            line = media::dedup_key(media::HashAlgorithm::Sha256, line);
         }
+        checksums_.insert(line);
     }
     std::cout << "Loaded " << checksums_.size() << " checksums from file" << std::endl;
 }
 
-void MediaUploadServiceImpl::save_checksum(const std::string& checksum) {
+void MediaUploadServiceImpl::save_checksum(const std::string& key) {
     std::ofstream ofs(checksums_file_, std::ios::app);
     if (ofs.is_open()) {
-        ofs << checksum << "\n";
+        ofs << key << "\n";
         ofs.flush();
     }
 }
 
 grpc::Status MediaUploadServiceImpl::Upload(grpc::ServerContext* context, grpc::ServerReader<media::UploadRequest>* reader, media::UploadStatus* response) {
+    std::string traceparent;
+    auto tp = context->client_metadata().find("traceparent");
+    if (tp != context->client_metadata().end()) traceparent.assign(tp->second.data(), tp->second.size());
+    media::TraceContext trace = media::Tracer::continue_trace(traceparent);
+    media::Span receive_span(trace, "upload.receive");
+
+    // Read() clears the request first, freeing the oneof Chunk, so every
+    // chunk costs a Chunk and a data buffer (about three allocations).
+    // Heap-allocated on purpose: on an arena each of those would stay alive
+    // until the end of the stream.
     media::UploadRequest req;
     media::FileInfo info;
     bool got_info = false;
-    std::string tmpdir = std::filesystem::temp_directory_path().string();
-    std::string temp_file = tmpdir + "/upload_" + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + "_" + std::to_string(std::time(nullptr));
+    // Staged next to the object store so publishing is a same-filesystem rename.
+    std::string temp_file = store_.new_staging_path();
     
-    std::ofstream ofs(temp_file, std::ios::binary);
+    // Unbuffered: chunks are already large, so write them straight through
+    // instead of copying them into the stream buffer first.
+    std::ofstream ofs;
+    ofs.rdbuf()->pubsetbuf(nullptr, 0);
+    ofs.open(temp_file, std::ios::binary);
     if (!ofs) {
         response->set_accepted(false);
         response->set_message("server error: cannot open temp file");
@@ -65,6 +111,8 @@ grpc::Status MediaUploadServiceImpl::Upload(grpc::ServerContext* context, grpc::
         }
     }
     ofs.close();
+    receive_span.set_args(media::Tracer::arg("file", info.filename()));
+    receive_span.end();
     
     if (!got_info) {
         response->set_accepted(false);
@@ -73,7 +121,17 @@ grpc::Status MediaUploadServiceImpl::Upload(grpc::ServerContext* context, grpc::
         return grpc::Status::OK;
     }
     
-    std::string checksum = sha256_file(temp_file);
+    media::HashAlgorithm algo;
+    if (!media::parse_hash_algorithm(info.hash_algorithm(), &algo)) {
+        response->set_accepted(false);
+        response->set_message("unsupported hash algorithm: " + info.hash_algorithm());
+        std::filesystem::remove(temp_file);
+        return grpc::Status::OK;
+    }
+
+    media::Span hash_span(trace, "upload.hash");
+    std::string checksum = media::hash_file(temp_file, algo);
+    hash_span.end();
     
     if (checksum.empty()) {
         std::cout << "ERROR: Failed to compute checksum for " << temp_file << std::endl;
@@ -83,9 +141,18 @@ grpc::Status MediaUploadServiceImpl::Upload(grpc::ServerContext* context, grpc::
         return grpc::Status::OK;
     }
     
+    if (!info.checksum().empty() && info.checksum() != checksum) {
+        std::cout << "Checksum mismatch: " << info.filename() << " (" << media::hash_algorithm_name(algo) << ")" << std::endl;
+        response->set_accepted(false);
+        response->set_message("checksum mismatch");
+        std::filesystem::remove(temp_file);
+        return grpc::Status::OK;
+    }
+
+    std::string key = media::dedup_key(algo, checksum);
     {
         std::lock_guard<std::mutex> lk(checksums_mtx_);
-        if (checksums_.count(checksum)) {
+        if (checksums_.count(key)) {
             response->set_accepted(false);
             response->set_message("duplicate");
             response->set_duplicate(true);
@@ -102,9 +169,18 @@ grpc::Status MediaUploadServiceImpl::Upload(grpc::ServerContext* context, grpc::
     item.producer_id = info.producer_id();
     item.filesize = info.filesize();
     item.checksum = checksum;
+    item.hash_algorithm = media::hash_algorithm_name(algo);
+    item.trace = trace;
 
-    bool enq = queue_.try_push(std::move(item));
+    // Journaled before the producer hears "enqueued" so a crash or restart
+    // never loses an upload the producer considers done.
+    media::Span journal_span(trace, "upload.journal");
+    journal_.append_accepted(item);
+    journal_span.end();
+    if (trace.sampled) item.enqueued_us = media::Tracer::now_us();
+    bool enq = pool_->try_enqueue(std::move(item));
     if (!enq) {
+        journal_.mark_done(temp_file);
         response->set_accepted(false);
         response->set_message("queue full");
         std::filesystem::remove(temp_file);
@@ -113,8 +189,8 @@ grpc::Status MediaUploadServiceImpl::Upload(grpc::ServerContext* context, grpc::
 
     {
         std::lock_guard<std::mutex> lk(checksums_mtx_);
-        checksums_.insert(checksum);
-        save_checksum(checksum);
+        checksums_.insert(key);
+        save_checksum(key);
     }
 
     response->set_accepted(true);
@@ -125,14 +201,18 @@ grpc::Status MediaUploadServiceImpl::Upload(grpc::ServerContext* context, grpc::
 
 void MediaUploadServiceImpl::start_workers() {
     pool_->start();
-    std::thread([this]{
-        while (true) {
-            UploadItem it = queue_.pop_blocking();
-            pool_->enqueue(std::move(it));
+    replay_ = std::thread([this, recovered = std::move(recovered_)]() mutable {
+        for (auto& it : recovered) {
+            std::cout << "Replaying journaled upload: " << it.filename << std::endl;
+            if (!pool_->enqueue(std::move(it))) break;
         }
-    }).detach();
+    });
 }
 
-void MediaUploadServiceImpl::stop_workers() {
-    pool_->stop();
-}
\ No newline at end of file
+bool MediaUploadServiceImpl::stop_workers(std::chrono::milliseconds drain_timeout) {
+    bool drained = pool_->stop(drain_timeout);
+    // The pool is closed now, so a replay still blocked on it returns.
+    if (replay_.joinable()) replay_.join();
+    if (!drained) journal_.sync();
+    return drained;
+}
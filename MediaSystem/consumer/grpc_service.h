@@ -2,16 +2,20 @@
 #include "media.grpc.pb.h"
 #include "media.pb.h"
 #include "worker.h"
-#include "bounded_queue.h"
+#include "object_store.h"
+#include "journal.h"
 #include <grpcpp/grpcpp.h>
 #include <unordered_set>
 #include <mutex>
 #include <functional>
 #include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
 
 class MediaUploadServiceImpl final : public media::MediaUpload::Service {
 public:
-    MediaUploadServiceImpl(size_t queue_capacity,
+    MediaUploadServiceImpl(const WorkerConfig& workers,
                           const std::string& storage_dir,
                           const std::string& preview_dir,
                           std::function<void(const UploadItem&, const std::string&, const std::string&)> notify);
@@ -19,22 +23,32 @@ public:
     grpc::Status Upload(grpc::ServerContext* context, grpc::ServerReader<media::UploadRequest>* reader, media::UploadStatus* response) override;
 
     void start_workers();
-    void stop_workers();
+    // Graceful drain: stops taking uploads and gives queued items up to
+    // drain_timeout to finish. Whatever is left is replayed from the journal
+    // on the next start. Returns false if the drain timed out; worker
+    // threads are then still running against this service, so it must not
+    // be destroyed (the journal is synced, the process should just exit).
+    bool stop_workers(std::chrono::milliseconds drain_timeout = std::chrono::milliseconds(0));
     
     size_t get_duplicate_count() const { return duplicate_count_.load(); }
+    std::vector<StageStats> get_stage_stats() const { return pool_->stats(); }
+    ObjectStore& store() { return store_; }
 
 private:
     void load_checksums();
-    void save_checksum(const std::string& checksum);
+    void save_checksum(const std::string& key);
+    void recover_journal();
     
-    BoundedQueue<UploadItem> queue_;
     std::unordered_set<std::string> checksums_;
     std::mutex checksums_mtx_;
     WorkerPool* pool_;
-    size_t queue_capacity_;
     std::string storage_dir_;
     std::string preview_dir_;
+    ObjectStore store_;
     std::string checksums_file_;
+    WorkJournal journal_;
+    std::vector<UploadItem> recovered_;
+    std::thread replay_;
     std::function<void(const UploadItem&, const std::string&, const std::string&)> notify_;
     std::atomic<size_t> duplicate_count_{0};
 };
\ No newline at end of file
@@ -0,0 +1,166 @@
+#include "journal.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unordered_map>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+static std::string escape_field(const std::string& s) {
+    std::string out;
+    out.reserve(s.size());
+    for (char c : s) {
+        switch (c) {
+            case '\\': out += "\\\\"; break;
+            case '\t': out += "\\t"; break;
+            case '\n': out += "\\n"; break;
+            default: out.push_back(c);
+        }
+    }
+    return out;
+}
+
+static std::string unescape_field(const std::string& s) {
+    std::string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '\\' && i + 1 < s.size()) {
+            char n = s[++i];
+            out.push_back(n == 't' ? '\t' : n == 'n' ? '\n' : n);
+        } else {
+            out.push_back(s[i]);
+        }
+    }
+    return out;
+}
+
+static std::vector<std::string> split_tabs(const std::string& line) {
+    std::vector<std::string> fields;
+    std::string cur;
+    for (char c : line) {
+        if (c == '\t') { fields.push_back(unescape_field(cur)); cur.clear(); }
+        else cur.push_back(c);
+    }
+    fields.push_back(unescape_field(cur));
+    return fields;
+}
+
+static std::string accepted_line(const UploadItem& item) {
+    std::ostringstream ss;
+    ss << "A\t" << escape_field(item.temp_path)
+       << "\t" << escape_field(item.checksum)
+       << "\t" << escape_field(item.hash_algorithm)
+       << "\t" << item.filesize
+       << "\t" << escape_field(item.producer_id)
+       << "\t" << escape_field(item.filename) << "\n";
+    return ss.str();
+}
+
+WorkJournal::WorkJournal(const std::string& path) : path_(path) {}
+
+WorkJournal::~WorkJournal() {
+    if (fp_) std::fclose(fp_);
+}
+
+std::vector<UploadItem> WorkJournal::recover(const ObjectStore& store) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    std::vector<UploadItem> pending;
+    std::unordered_map<std::string, size_t> index;
+
+    std::ifstream ifs(path_);
+    std::string line;
+    while (std::getline(ifs, line)) {
+        // A torn final line from a crash mid-write simply fails to parse.
+        auto f = split_tabs(line);
+        if (f.size() == 7 && f[0] == "A") {
+            UploadItem item;
+            item.temp_path = f[1];
+            item.checksum = f[2];
+            item.hash_algorithm = f[3];
+            try { item.filesize = std::stoll(f[4]); } catch (...) { continue; }
+            item.producer_id = f[5];
+            item.filename = f[6];
+            index[item.temp_path] = pending.size();
+            pending.push_back(std::move(item));
+        } else if (f.size() == 2 && f[0] == "D") {
+            auto it = index.find(f[1]);
+            if (it != index.end()) {
+                pending[it->second].temp_path.clear();
+                index.erase(it);
+            }
+        }
+    }
+    ifs.close();
+
+    std::vector<UploadItem> live;
+    for (auto& item : pending) {
+        if (item.temp_path.empty()) continue;
+        std::error_code ec;
+        if (!std::filesystem::exists(item.temp_path, ec)) {
+            // Finalized before the crash: resume from the object.
+            if (!store.contains(item.checksum)) {
+                std::cerr << "journal: dropping " << item.filename << ", neither staged file nor object exists" << std::endl;
+                continue;
+            }
+            item.stored_path = store.object_path(item.checksum);
+        }
+        live.push_back(std::move(item));
+    }
+
+    // Compact: the rewritten journal holds only what is still outstanding.
+    std::string tmp = path_ + ".compact";
+    {
+        std::ofstream ofs(tmp, std::ios::trunc | std::ios::binary);
+        for (const auto& item : live) ofs << accepted_line(item);
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, path_, ec);
+    if (ec) std::cerr << "journal compaction failed: " << ec.message() << std::endl;
+
+    open_for_append();
+    return live;
+}
+
+void WorkJournal::open_for_append() {
+    if (fp_) std::fclose(fp_);
+    fp_ = std::fopen(path_.c_str(), "ab");
+    if (!fp_) std::cerr << "Failed to open work journal: " << path_ << std::endl;
+}
+
+void WorkJournal::write_line(const std::string& line, bool sync) {
+    if (!fp_) return;
+    std::fwrite(line.data(), 1, line.size(), fp_);
+    std::fflush(fp_);
+    if (sync) sync_locked();
+}
+
+void WorkJournal::sync_locked() {
+    if (!fp_) return;
+    std::fflush(fp_);
+#ifdef _WIN32
+    _commit(_fileno(fp_));
+#else
+    fsync(fileno(fp_));
+#endif
+}
+
+void WorkJournal::sync() {
+    std::lock_guard<std::mutex> lk(mtx_);
+    sync_locked();
+}
+
+void WorkJournal::append_accepted(const UploadItem& item) {
+    std::string line = accepted_line(item);
+    std::lock_guard<std::mutex> lk(mtx_);
+    write_line(line, true);
+}
+
+void WorkJournal::mark_done(const std::string& temp_path) {
+    std::string line = "D\t" + escape_field(temp_path) + "\n";
+    std::lock_guard<std::mutex> lk(mtx_);
+    write_line(line, false);
+}
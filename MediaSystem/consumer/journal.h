@@ -0,0 +1,48 @@
+#pragma once
+#include "worker.h"
+#include "object_store.h"
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Append-only log of uploads that were accepted (checksum recorded, producer
+// told "enqueued") but not yet fully processed.
+//
+//   A <temp_path> <checksum> <hash_algorithm> <filesize> <producer_id> <filename>
+//   D <temp_path>
+//
+// Fields are tab separated with \t, \n and \\ escaped. "A" records are synced
+// to disk before the producer gets its reply; "D" records only need a flush,
+// since every stage is idempotent and a lost "D" merely repeats some work.
+//
+// An item's staged file disappears as soon as the finalize stage moves it
+// into the object store, long before its "D" record. Such items are replayed
+// from the stored object rather than dropped; otherwise their checksum would
+// stay registered while the upload never got a preview or catalog row.
+class WorkJournal {
+public:
+    explicit WorkJournal(const std::string& path);
+    ~WorkJournal();
+
+    // Items accepted by a previous run that never completed. Items whose
+    // staged file is gone but whose object is in store come back with
+    // stored_path set, so finalize skips the move. Items with neither are
+    // dropped. Rewrites the journal to contain just the returned entries.
+    // Must be called once, before any append.
+    std::vector<UploadItem> recover(const ObjectStore& store);
+
+    void append_accepted(const UploadItem& item);
+    void mark_done(const std::string& temp_path);
+    // Forces everything written so far (including "D" records) to disk.
+    void sync();
+
+private:
+    void open_for_append();
+    void write_line(const std::string& line, bool sync);
+    void sync_locked();
+
+    std::string path_;
+    std::mutex mtx_;
+    FILE* fp_ = nullptr;
+};
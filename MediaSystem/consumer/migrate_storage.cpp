@@ -0,0 +1,151 @@
+// Converts a flat uploads directory (one file per upload, named after the
+// original filename) into the content-addressed ObjectStore layout.
+//
+//   migrate_storage <storage_dir> [--dry-run]
+//
+// Every regular file directly under storage_dir is hashed, moved into
+// objects/<aa>/<bb>/<checksum> and replaced by a hardlink alias in names/.
+// metadata.db rows and .uploads.jsonl URLs are rewritten to the new paths.
+// Files whose content is already stored are folded into the existing object.
+// Safe to re-run: already migrated files are no longer in the flat directory.
+
+#include "object_store.h"
+#include "sha256.h"
+#include <sqlite3.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct Moved {
+    std::string old_name;
+    std::string checksum;
+    std::string object;
+    std::string alias;
+};
+
+static bool is_reserved(const std::string& name) {
+    return name.empty() || name[0] == '.' || name.rfind("metadata.db", 0) == 0;
+}
+
+static void update_catalog(const std::string& storage_dir, const std::vector<Moved>& moved) {
+    sqlite3* db = nullptr;
+    std::string dbfile = storage_dir + "/metadata.db";
+    if (!fs::exists(dbfile)) return;
+    if (sqlite3_open(dbfile.c_str(), &db) != SQLITE_OK) {
+        std::cerr << "Failed to open sqlite db: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_close(db);
+        return;
+    }
+    char* err = nullptr;
+    sqlite3_exec(db, "ALTER TABLE uploads ADD COLUMN alias TEXT;", nullptr, nullptr, &err);
+    if (err) sqlite3_free(err);  // column already present
+
+    sqlite3_exec(db, "BEGIN;", nullptr, nullptr, nullptr);
+    // Exact match on the old flat path: LIKE would treat '_' and '%' in
+    // filenames as wildcards and compare ASCII case-insensitively.
+    const char* sql = "UPDATE uploads SET path=?, alias=? WHERE checksum=? OR path=?;";
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
+        for (const auto& m : moved) {
+            std::string old_path = storage_dir + "/" + m.old_name;
+            sqlite3_bind_text(stmt, 1, m.object.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 2, m.alias.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 3, m.checksum.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 4, old_path.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+        }
+        sqlite3_finalize(stmt);
+    }
+    sqlite3_exec(db, "COMMIT;", nullptr, nullptr, nullptr);
+    sqlite3_close(db);
+}
+
+static void update_jsonl(const std::string& storage_dir, const std::vector<Moved>& moved) {
+    std::string meta = storage_dir + "/.uploads.jsonl";
+    std::ifstream ifs(meta);
+    if (!ifs.is_open()) return;
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(ifs, line)) {
+        for (const auto& m : moved) {
+            std::string from = "\"/uploads/" + m.old_name + "\"";
+            std::string to = m.alias.empty()
+                ? "\"/uploads/" + ObjectStore::object_url_path(m.checksum) + "\""
+                : "\"/uploads/names/" + m.alias + "\"";
+            size_t pos = line.find(from);
+            if (pos != std::string::npos) {
+                line.replace(pos, from.size(), to);
+                break;
+            }
+        }
+        lines.push_back(line);
+    }
+    ifs.close();
+
+    std::string tmp = meta + ".migrating";
+    {
+        std::ofstream ofs(tmp, std::ios::trunc);
+        for (const auto& l : lines) ofs << l << "\n";
+    }
+    fs::rename(tmp, meta);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: migrate_storage <storage_dir> [--dry-run]" << std::endl;
+        return 1;
+    }
+    std::string storage_dir = argv[1];
+    // Old rows store "<storage_dir>/<name>"; compare without a trailing slash.
+    while (storage_dir.size() > 1 && (storage_dir.back() == '/' || storage_dir.back() == '\\')) storage_dir.pop_back();
+    bool dry_run = argc > 2 && std::string(argv[2]) == "--dry-run";
+
+    if (!fs::is_directory(storage_dir)) {
+        std::cerr << "Not a directory: " << storage_dir << std::endl;
+        return 1;
+    }
+
+    std::vector<fs::path> flat;
+    for (auto& p : fs::directory_iterator(storage_dir)) {
+        if (!p.is_regular_file()) continue;
+        if (is_reserved(p.path().filename().string())) continue;
+        flat.push_back(p.path());
+    }
+    std::cout << "Found " << flat.size() << " flat files in " << storage_dir << std::endl;
+    if (dry_run) {
+        for (const auto& p : flat) std::cout << "  " << p.filename().string() << std::endl;
+        return 0;
+    }
+
+    ObjectStore store(storage_dir);
+    std::vector<Moved> moved;
+    for (const auto& p : flat) {
+        Moved m;
+        m.old_name = p.filename().string();
+        m.checksum = sha256_file(p.string());
+        if (m.checksum.empty()) {
+            std::cerr << "Skipping unreadable file: " << p.string() << std::endl;
+            continue;
+        }
+        try {
+            m.object = store.put(p.string(), m.checksum);
+            m.alias = store.link_alias(m.checksum, m.old_name);
+        } catch (const std::exception& ex) {
+            std::cerr << "Failed to migrate " << m.old_name << ": " << ex.what() << std::endl;
+            continue;
+        }
+        std::cout << "  " << m.old_name << " -> " << ObjectStore::object_url_path(m.checksum) << std::endl;
+        moved.push_back(std::move(m));
+    }
+
+    update_catalog(storage_dir, moved);
+    update_jsonl(storage_dir, moved);
+
+    std::cout << "Migrated " << moved.size() << " of " << flat.size() << " files" << std::endl;
+    return moved.size() == flat.size() ? 0 : 2;
+}
@@ -0,0 +1,126 @@
+#include "object_store.h"
+#include <filesystem>
+#include <stdexcept>
+#include <thread>
+#include <chrono>
+#include <cctype>
+
+namespace fs = std::filesystem;
+
+static bool valid_checksum(const std::string& checksum) {
+    if (checksum.size() < 4) return false;
+    for (char c : checksum) {
+        if (!std::isxdigit(static_cast<unsigned char>(c))) return false;
+    }
+    return true;
+}
+
+ObjectStore::ObjectStore(const std::string& root)
+: root_(root),
+  objects_dir_(root + "/objects"),
+  names_dir_(root + "/names"),
+  staging_dir_(root + "/.staging") {
+    fs::create_directories(objects_dir_);
+    fs::create_directories(names_dir_);
+    fs::create_directories(staging_dir_);
+}
+
+std::string ObjectStore::new_staging_path() {
+    uint64_t seq = staging_seq_.fetch_add(1);
+    return staging_dir_ + "/upload_" +
+           std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + "_" +
+           std::to_string(std::chrono::system_clock::now().time_since_epoch().count()) + "_" +
+           std::to_string(seq);
+}
+
+std::string ObjectStore::object_path(const std::string& checksum) const {
+    return objects_dir_ + "/" + checksum.substr(0, 2) + "/" + checksum.substr(2, 2) + "/" + checksum;
+}
+
+std::string ObjectStore::object_url_path(const std::string& checksum) {
+    return "objects/" + checksum.substr(0, 2) + "/" + checksum.substr(2, 2) + "/" + checksum;
+}
+
+bool ObjectStore::contains(const std::string& checksum) const {
+    std::error_code ec;
+    return valid_checksum(checksum) && fs::is_regular_file(object_path(checksum), ec);
+}
+
+// Publishes src at dest without ever replacing an existing object: link()
+// fails if dest exists, so concurrent puts of the same content keep the
+// first object (and any aliases already linked to it) intact.
+static bool publish_no_clobber(const std::string& src, const std::string& dest) {
+    std::error_code ec;
+    fs::create_hard_link(src, dest, ec);
+    if (!ec || fs::exists(dest)) {
+        fs::remove(src, ec);
+        return true;
+    }
+    return false;
+}
+
+std::string ObjectStore::put(const std::string& src, const std::string& checksum) {
+    if (!valid_checksum(checksum)) {
+        throw std::runtime_error("object store: malformed checksum '" + checksum + "'");
+    }
+    std::string dest = object_path(checksum);
+    std::error_code ec;
+    if (fs::exists(dest, ec)) {
+        fs::remove(src, ec);
+        return dest;
+    }
+    fs::create_directories(fs::path(dest).parent_path());
+
+    if (publish_no_clobber(src, dest)) return dest;
+
+    // Most likely a cross-device move: copy next to the objects first so the
+    // object still never appears half written.
+    // src is removed only once the object is in place, so a failed copy
+    // (e.g. a full disk) leaves the journaled staged file for a replay.
+    std::string staged = new_staging_path();
+    try {
+        fs::copy_file(src, staged, fs::copy_options::overwrite_existing);
+        // No hardlink support at all; fall back to an atomic rename.
+        if (!publish_no_clobber(staged, dest)) fs::rename(staged, dest);
+    } catch (...) {
+        fs::remove(staged, ec);
+        throw;
+    }
+    fs::remove(src, ec);
+    return dest;
+}
+
+std::string ObjectStore::sanitize_filename(const std::string& filename) {
+    std::string name = fs::path(filename).filename().string();
+    if (name.empty() || name == "." || name == "..") return "unnamed";
+    return name;
+}
+
+std::string ObjectStore::link_alias(const std::string& checksum, const std::string& filename) {
+    std::string object = object_path(checksum);
+    fs::path base(sanitize_filename(filename));
+    std::string stem = base.stem().string();
+    std::string ext = base.extension().string();
+
+    for (int n = 0; n < 1000; ++n) {
+        std::string alias = n == 0 ? base.string() : stem + " (" + std::to_string(n) + ")" + ext;
+        std::string link = names_dir_ + "/" + alias;
+        std::error_code ec;
+        fs::create_hard_link(object, link, ec);
+        if (!ec) return alias;
+
+        if (fs::exists(link)) {
+            // Re-uploading an identical name for the same content reuses the alias.
+            std::error_code eq_ec;
+            if (fs::equivalent(object, link, eq_ec)) return alias;
+            continue;
+        }
+        // Hardlinks unsupported (FAT, some network shares): catalog-only alias.
+        return "";
+    }
+    return "";
+}
+
+std::string ObjectStore::alias_path(const std::string& alias) const {
+    return names_dir_ + "/" + sanitize_filename(alias);
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <string>
+#include <atomic>
+#include <cstdint>
+
+// Content-addressed object store.
+//
+// Layout under root:
+//   objects/<c0c1>/<c2c3>/<checksum>   one file per unique content
+//   names/<filename>                   hardlink alias to an object
+//   .staging/                          in-flight uploads (same filesystem as objects)
+//
+// The two-level hash-prefix fan-out keeps every directory small no matter how
+// many objects are stored. Objects are published by hardlinking the fully
+// written staged file to its final name and then unlinking the staged name.
+// link() never replaces an existing file, so a published object (and the
+// aliases hardlinked to it) is never clobbered, and a reader never sees a
+// partially written object.
+class ObjectStore {
+public:
+    explicit ObjectStore(const std::string& root);
+
+    const std::string& root() const { return root_; }
+    const std::string& staging_dir() const { return staging_dir_; }
+    const std::string& names_dir() const { return names_dir_; }
+
+    // Unique path inside staging_dir() for a new upload.
+    std::string new_staging_path();
+
+    std::string object_path(const std::string& checksum) const;
+    bool contains(const std::string& checksum) const;
+
+    // Moves src into the store under checksum and returns the object path.
+    // If the object already exists src is simply removed. Publishing is a
+    // no-clobber hardlink followed by unlinking src; if src is on another
+    // filesystem it is copied into staging first and linked from there. Only
+    // when the filesystem has no hardlinks at all does it fall back to
+    // rename(), which is atomic but would replace an object published
+    // concurrently (with identical content, so readers are unaffected).
+    // Throws std::runtime_error on a malformed checksum or
+    // std::filesystem::filesystem_error on I/O failure.
+    std::string put(const std::string& src, const std::string& checksum);
+
+    // Creates a human-readable hardlink under names/ pointing at the object.
+    // Collisions are resolved by suffixing " (n)" before the extension; the
+    // link syscall itself fails if the name is taken, so concurrent workers
+    // cannot clobber each other. Returns the alias chosen, or "" if the
+    // filesystem does not support hardlinks (the catalog still records it).
+    std::string link_alias(const std::string& checksum, const std::string& filename);
+    std::string alias_path(const std::string& alias) const;
+
+    // URL path (relative to the storage mount) for an object or alias.
+    static std::string object_url_path(const std::string& checksum);
+
+    // Strips any directory components from a client supplied filename.
+    static std::string sanitize_filename(const std::string& filename);
+
+private:
+    std::string root_;
+    std::string objects_dir_;
+    std::string names_dir_;
+    std::string staging_dir_;
+    std::atomic<uint64_t> staging_seq_{0};
+};
@@ -0,0 +1,122 @@
+#include "probe.h"
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+#ifdef MEDIA_HAVE_LIBAV
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+}
+#endif
+
+static std::string first_token(const std::string& names) {
+    return names.substr(0, names.find(','));
+}
+
+#ifdef MEDIA_HAVE_LIBAV
+
+bool probe_media(const std::string& path, MediaInfo* out, std::string* err) {
+    AVFormatContext* fmt = nullptr;
+    int rc = avformat_open_input(&fmt, path.c_str(), nullptr, nullptr);
+    if (rc < 0) {
+        char buf[AV_ERROR_MAX_STRING_SIZE] = {0};
+        av_strerror(rc, buf, sizeof(buf));
+        if (err) *err = buf;
+        return false;
+    }
+    if (avformat_find_stream_info(fmt, nullptr) < 0) {
+        if (err) *err = "no stream info";
+        avformat_close_input(&fmt);
+        return false;
+    }
+
+    out->container = first_token(fmt->iformat->name);
+    if (fmt->duration != AV_NOPTS_VALUE) out->duration_ms = fmt->duration / (AV_TIME_BASE / 1000);
+    out->bitrate = fmt->bit_rate;
+
+    for (unsigned i = 0; i < fmt->nb_streams; ++i) {
+        const AVStream* st = fmt->streams[i];
+        const AVCodecParameters* par = st->codecpar;
+        if (par->codec_type == AVMEDIA_TYPE_VIDEO && out->video_codec.empty() &&
+            !(st->disposition & AV_DISPOSITION_ATTACHED_PIC)) {
+            out->video_codec = avcodec_get_name(par->codec_id);
+            out->width = par->width;
+            out->height = par->height;
+            if (st->avg_frame_rate.den != 0) out->fps = av_q2d(st->avg_frame_rate);
+        } else if (par->codec_type == AVMEDIA_TYPE_AUDIO && out->audio_codec.empty()) {
+            out->audio_codec = avcodec_get_name(par->codec_id);
+        }
+    }
+    avformat_close_input(&fmt);
+    return true;
+}
+
+#else
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+// "a=1|b=2" -> value of key, or "".
+static std::string field(const std::string& line, const std::string& key) {
+    std::string needle = "|" + key + "=";
+    size_t pos = line.find(needle);
+    if (pos == std::string::npos) return "";
+    pos += needle.size();
+    return line.substr(pos, line.find('|', pos) - pos);
+}
+
+static double parse_rate(const std::string& s) {
+    size_t slash = s.find('/');
+    if (slash == std::string::npos) return std::atof(s.c_str());
+    double den = std::atof(s.c_str() + slash + 1);
+    return den != 0 ? std::atof(s.substr(0, slash).c_str()) / den : 0;
+}
+
+bool probe_media(const std::string& path, MediaInfo* out, std::string* err) {
+    std::string cmd = "ffprobe -v error -of compact"
+                      " -show_entries format=format_name,duration,bit_rate:stream=codec_type,codec_name,width,height,avg_frame_rate"
+                      " \"" + path + "\"";
+    FILE* pipe = popen(cmd.c_str(), "r");
+    if (!pipe) {
+        if (err) *err = "cannot run ffprobe";
+        return false;
+    }
+    std::string text;
+    char buf[4096];
+    size_t n;
+    while ((n = std::fread(buf, 1, sizeof(buf), pipe)) > 0) text.append(buf, n);
+    int rc = pclose(pipe);
+
+    bool got_format = false;
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.rfind("stream|", 0) == 0) {
+            std::string type = field(line, "codec_type");
+            if (type == "video" && out->video_codec.empty()) {
+                out->video_codec = field(line, "codec_name");
+                out->width = std::atoi(field(line, "width").c_str());
+                out->height = std::atoi(field(line, "height").c_str());
+                out->fps = parse_rate(field(line, "avg_frame_rate"));
+            } else if (type == "audio" && out->audio_codec.empty()) {
+                out->audio_codec = field(line, "codec_name");
+            }
+        } else if (line.rfind("format|", 0) == 0) {
+            got_format = true;
+            out->container = first_token(field(line, "format_name"));
+            out->duration_ms = static_cast<int64_t>(std::atof(field(line, "duration").c_str()) * 1000);
+            out->bitrate = std::atoll(field(line, "bit_rate").c_str());
+        }
+    }
+    if (rc != 0 || !got_format) {
+        if (err) *err = "ffprobe failed rc=" + std::to_string(rc);
+        return false;
+    }
+    return true;
+}
+
+#endif
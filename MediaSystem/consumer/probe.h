@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Container and stream metadata for an uploaded file.
+struct MediaInfo {
+    std::string container;      // first demuxer name, e.g. "mov" or "matroska"
+    std::string video_codec;
+    std::string audio_codec;
+    int64_t duration_ms = 0;
+    int64_t bitrate = 0;        // bits per second, whole container
+    int width = 0;
+    int height = 0;
+    double fps = 0;
+};
+
+// Reads the container header and stream parameters without decoding.
+// Built against libavformat this runs in-process; otherwise it falls back to
+// running ffprobe. Returns false (with err set) if the file is not media.
+bool probe_media(const std::string& path, MediaInfo* out, std::string* err);
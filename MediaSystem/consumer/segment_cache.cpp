@@ -0,0 +1,44 @@
+#include "segment_cache.h"
+#include <fstream>
+#include <sstream>
+
+SegmentCache::SegmentCache(size_t capacity_bytes) : capacity_(capacity_bytes) {}
+
+std::shared_ptr<const std::string> SegmentCache::get(const std::string& path) {
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        auto it = index_.find(path);
+        if (it != index_.end()) {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            ++hits_;
+            return it->second->second;
+        }
+        ++misses_;
+    }
+
+    // Read outside the lock so a slow disk does not stall cache hits.
+    std::ifstream ifs(path, std::ios::binary);
+    if (!ifs.is_open()) return nullptr;
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    auto data = std::make_shared<const std::string>(ss.str());
+    if (data->size() > capacity_) return data;
+
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto it = index_.find(path);
+    if (it != index_.end()) return it->second->second;   // another request loaded it meanwhile
+    lru_.emplace_front(path, data);
+    index_[path] = lru_.begin();
+    bytes_ += data->size();
+    while (bytes_ > capacity_ && !lru_.empty()) {
+        bytes_ -= lru_.back().second->size();
+        index_.erase(lru_.back().first);
+        lru_.pop_back();
+    }
+    return data;
+}
+
+SegmentCache::Stats SegmentCache::stats() const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    return Stats{hits_, misses_, index_.size(), bytes_};
+}
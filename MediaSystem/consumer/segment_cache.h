@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Byte-bounded LRU cache of packaged HLS files (playlists, init segments,
+// media segments).
+//
+// Packaged output lives under a checksum directory that is published once
+// and never rewritten, so cached bytes never go stale and need no
+// revalidation. Viewers of the same upload share one copy in memory instead
+// of each request reopening the file.
+class SegmentCache {
+public:
+    explicit SegmentCache(size_t capacity_bytes);
+
+    // Contents of path, from memory when cached. nullptr if it cannot be read.
+    // Files larger than the whole cache are returned but not kept.
+    std::shared_ptr<const std::string> get(const std::string& path);
+
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        size_t entries;
+        size_t bytes;
+    };
+    Stats stats() const;
+
+private:
+    using Entry = std::pair<std::string, std::shared_ptr<const std::string>>;
+
+    size_t capacity_;
+    size_t bytes_ = 0;
+    uint64_t hits_ = 0;
+    uint64_t misses_ = 0;
+    mutable std::mutex mtx_;
+    std::list<Entry> lru_;   // front = most recently used
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+};
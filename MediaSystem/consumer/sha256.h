@@ -1,34 +1,7 @@
 #pragma once
 #include <string>
-#include <fstream>
-#include <sstream>
-#include <iomanip>
-#include <openssl/sha.h>
+#include "common/hash.h"
 
 inline std::string sha256_file(const std::string& filepath) {
-    std::ifstream file(filepath, std::ios::binary);
-    if (!file.is_open()) {
-        return "";
-    }
-
-    SHA256_CTX sha256;
-    SHA256_Init(&sha256);
-
-    char buffer[8192];
-    while (file.read(buffer, sizeof(buffer))) {
-        SHA256_Update(&sha256, buffer, file.gcount());
-    }
-    if (file.gcount() > 0) {
-        SHA256_Update(&sha256, buffer, file.gcount());
-    }
-
-    unsigned char hash[SHA256_DIGEST_LENGTH];
-    SHA256_Final(hash, &sha256);
-
-    std::stringstream ss;
-    for (int i = 0; i < SHA256_DIGEST_LENGTH; i++) {
-        ss << std::hex << std::setw(2) << std::setfill('0') << (int)hash[i];
-    }
-
-    return ss.str();
-}
\ No newline at end of file
+    return media::hash_file(filepath, media::HashAlgorithm::Sha256);
+}
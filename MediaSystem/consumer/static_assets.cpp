@@ -0,0 +1,211 @@
+#include "static_assets.h"
+#include "common/blake3.h"
+#include "httplib.h"
+#include <zlib.h>
+#ifdef MEDIA_HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+// httplib built with its own compression support would encode our already
+// encoded bodies a second time; leave compression to it in that case.
+#if defined(CPPHTTPLIB_ZLIB_SUPPORT) || defined(CPPHTTPLIB_BROTLI_SUPPORT)
+static constexpr bool kCompress = false;
+#else
+static constexpr bool kCompress = true;
+#endif
+
+// Below this the encoding overhead is not worth a round of deflate.
+static constexpr size_t kMinCompressSize = 1024;
+
+static std::string gzip_compress(const std::string& in, int level) {
+    z_stream zs{};
+    if (deflateInit2(&zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) return "";
+    std::string out(deflateBound(&zs, static_cast<uLong>(in.size())), '\0');
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    zs.avail_in = static_cast<uInt>(in.size());
+    zs.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    zs.avail_out = static_cast<uInt>(out.size());
+    int rc = deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return rc == Z_STREAM_END ? out : "";
+}
+
+static std::string brotli_compress(const std::string& in, int quality) {
+#ifdef MEDIA_HAVE_BROTLI
+    size_t size = BrotliEncoderMaxCompressedSize(in.size());
+    if (size == 0) return "";
+    std::string out(size, '\0');
+    if (!BrotliEncoderCompress(quality, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, in.size(),
+                               reinterpret_cast<const uint8_t*>(in.data()), &size,
+                               reinterpret_cast<uint8_t*>(&out[0]))) {
+        return "";
+    }
+    out.resize(size);
+    return out;
+#else
+    (void)in; (void)quality;
+    return "";
+#endif
+}
+
+// True if the Accept-Encoding header lists coding with a non-zero q value.
+static bool accepts_encoding(const std::string& header, const char* coding) {
+    std::stringstream ss(header);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        size_t semi = item.find(';');
+        std::string name = item.substr(0, semi);
+        name.erase(0, name.find_first_not_of(" \t"));
+        name.erase(name.find_last_not_of(" \t") + 1);
+        if (name != coding) continue;
+        if (semi == std::string::npos) return true;
+        size_t q = item.find("q=", semi);
+        return q == std::string::npos || std::strtod(item.c_str() + q + 2, nullptr) > 0.0;
+    }
+    return false;
+}
+
+static bool etag_matches(const std::string& if_none_match, const std::string& etag) {
+    std::stringstream ss(if_none_match);
+    std::string tag;
+    while (std::getline(ss, tag, ',')) {
+        tag.erase(0, tag.find_first_not_of(" \t"));
+        tag.erase(tag.find_last_not_of(" \t") + 1);
+        if (tag.rfind("W/", 0) == 0) tag.erase(0, 2);   // If-None-Match uses weak comparison
+        if (tag == "*" || tag == etag) return true;
+    }
+    return false;
+}
+
+void set_compressed_content(const httplib::Request& req, httplib::Response& res,
+                            const std::string& body, const char* content_type) {
+    res.set_header("Vary", "Accept-Encoding");
+    if (kCompress && body.size() >= kMinCompressSize) {
+        const std::string accept = req.get_header_value("Accept-Encoding");
+        // Low brotli quality / default gzip level: these bodies change on
+        // every request, so encoding speed matters more than ratio.
+        std::string encoded;
+        const char* coding = nullptr;
+        if (accepts_encoding(accept, "br") && !(encoded = brotli_compress(body, 4)).empty()) coding = "br";
+        else if (accepts_encoding(accept, "gzip") && !(encoded = gzip_compress(body, Z_DEFAULT_COMPRESSION)).empty()) coding = "gzip";
+        if (coding && encoded.size() < body.size()) {
+            res.set_header("Content-Encoding", coding);
+            res.set_content(encoded, content_type);
+            return;
+        }
+    }
+    res.set_content(body, content_type);
+}
+
+StaticAssets::StaticAssets(const std::string& web_dir, bool dev_mode)
+: web_dir_(web_dir), dev_mode_(dev_mode) {}
+
+std::string StaticAssets::find_web_dir(const std::string& preferred) {
+    if (!preferred.empty()) return preferred;
+    // Binaries usually run from build/consumer/<Config>, sometimes from build/ or the repo.
+    for (const char* dir : {"../../../web", "../../web", "../web", "./web"}) {
+        std::error_code ec;
+        if (fs::exists(fs::path(dir) / "index.html", ec)) return dir;
+    }
+    return "../../../web";
+}
+
+std::shared_ptr<const StaticAssets::Asset> StaticAssets::load(const std::string& path, const std::string& content_type,
+                                                               const std::string& cache_control) const {
+    auto a = std::make_shared<Asset>();
+    a->path = path;
+    a->content_type = content_type;
+    a->cache_control = dev_mode_ ? "no-cache" : cache_control;
+
+    std::error_code ec;
+    a->mtime = fs::last_write_time(path, ec);
+    std::ifstream ifs(path, std::ios::binary);
+    if (ec || !ifs.is_open()) return a;
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    a->identity = ss.str();
+    a->found = true;
+
+    blake3::Blake3Hasher hasher;
+    hasher.update(a->identity.data(), a->identity.size());
+    uint8_t digest[blake3::OUT_LEN];
+    hasher.finalize(digest);
+    static const char* hex = "0123456789abcdef";
+    std::string tag;
+    for (size_t i = 0; i < 12; ++i) {
+        tag += hex[digest[i] >> 4];
+        tag += hex[digest[i] & 0xf];
+    }
+    a->etag = "\"" + tag + "\"";
+
+    // Static files are compressed once, so spend the time on the best ratio.
+    if (kCompress && a->identity.size() >= kMinCompressSize) {
+        std::string gz = gzip_compress(a->identity, Z_BEST_COMPRESSION);
+        if (!gz.empty() && gz.size() < a->identity.size()) a->gzip = std::move(gz);
+        std::string br = brotli_compress(a->identity, 11);
+        if (!br.empty() && br.size() < a->identity.size()) a->brotli = std::move(br);
+    }
+    return a;
+}
+
+bool StaticAssets::add(const std::string& url_path, const std::string& file,
+                       const std::string& content_type, const std::string& cache_control) {
+    auto a = load(web_dir_ + "/" + file, content_type, cache_control);
+    if (!a->found) {
+        std::cerr << "Static asset not found: " << a->path << std::endl;
+    } else {
+        std::cout << "Loaded " << a->path << " (" << a->identity.size() << " bytes, gzip " << a->gzip.size()
+                  << ", br " << a->brotli.size() << ")" << std::endl;
+    }
+    std::lock_guard<std::mutex> lk(mtx_);
+    assets_[url_path] = a;
+    return a->found;
+}
+
+bool StaticAssets::serve(const std::string& url_path, const httplib::Request& req, httplib::Response& res) {
+    std::shared_ptr<const Asset> a;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        auto it = assets_.find(url_path);
+        if (it == assets_.end()) return false;
+        a = it->second;
+        if (dev_mode_) {
+            std::error_code ec;
+            auto mtime = fs::last_write_time(a->path, ec);
+            if (!ec && (!a->found || mtime != a->mtime)) {
+                a = load(a->path, a->content_type, a->cache_control);
+                it->second = a;
+                std::cout << "Reloaded " << a->path << std::endl;
+            }
+        }
+    }
+    if (!a->found) return false;
+
+    const std::string accept = req.get_header_value("Accept-Encoding");
+    const std::string* body = &a->identity;
+    const char* coding = nullptr;
+    if (!a->brotli.empty() && accepts_encoding(accept, "br")) { body = &a->brotli; coding = "br"; }
+    else if (!a->gzip.empty() && accepts_encoding(accept, "gzip")) { body = &a->gzip; coding = "gzip"; }
+
+    // Each encoding is its own representation and needs its own strong tag.
+    std::string etag = a->etag;
+    if (coding) etag.insert(etag.size() - 1, std::string("-") + (coding[0] == 'b' ? "br" : "gz"));
+
+    res.set_header("ETag", etag);
+    res.set_header("Cache-Control", a->cache_control);
+    res.set_header("Vary", "Accept-Encoding");
+    if (req.has_header("If-None-Match") && etag_matches(req.get_header_value("If-None-Match"), etag)) {
+        res.status = 304;
+        return true;
+    }
+    if (coding) res.set_header("Content-Encoding", coding);
+    res.set_content(*body, a->content_type.c_str());
+    return true;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace httplib {
+struct Request;
+struct Response;
+}
+
+// Sets body as the response, compressed with the best encoding the client
+// accepts (br, then gzip). Small bodies are sent as they are.
+void set_compressed_content(const httplib::Request& req, httplib::Response& res,
+                            const std::string& body, const char* content_type);
+
+// Web UI files held in memory.
+//
+// Each file is read once, compressed once per encoding and tagged with a
+// strong ETag derived from its content, so a request is a map lookup plus a
+// header compare. In dev mode the file's mtime is checked on every request
+// and the asset is rebuilt when it changed.
+class StaticAssets {
+public:
+    StaticAssets(const std::string& web_dir, bool dev_mode);
+
+    // Registers url_path to serve web_dir/file. Returns false if the file
+    // cannot be read (the path then answers 404 until it appears in dev mode).
+    bool add(const std::string& url_path, const std::string& file,
+             const std::string& content_type, const std::string& cache_control);
+
+    // Writes the asset (or 304 Not Modified) into res. False if url_path is
+    // not registered or its file is missing.
+    bool serve(const std::string& url_path, const httplib::Request& req, httplib::Response& res);
+
+    const std::string& web_dir() const { return web_dir_; }
+
+    // preferred if set, else the first of a few paths relative to the
+    // working directory that contains index.html.
+    static std::string find_web_dir(const std::string& preferred);
+
+private:
+    struct Asset {
+        std::string path;
+        std::string content_type;
+        std::string cache_control;
+        bool found = false;
+        std::filesystem::file_time_type mtime;
+        std::string etag;        // of the identity body; encoded variants append -gz / -br
+        std::string identity;
+        std::string gzip;        // empty when it would not be smaller
+        std::string brotli;
+    };
+
+    std::shared_ptr<const Asset> load(const std::string& path, const std::string& content_type,
+                                      const std::string& cache_control) const;
+
+    std::string web_dir_;
+    bool dev_mode_;
+    std::mutex mtx_;
+    std::map<std::string, std::shared_ptr<const Asset>> assets_;
+};
@@ -1,113 +1,303 @@
 #include "worker.h"
 #include "bounded_queue.h"
 #include "sha256.h"
+#include "object_store.h"
+#include "catalog.h"
 #include <filesystem>
 #include <cstdlib>
 #include <iostream>
-#include <sqlite3.h>
 #include <fstream>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
 
-struct WorkerPool::Impl {
+namespace {
+
+// One pipeline stage: a bounded queue drained by its own threads. fn returns
+// false when it failed on the item, which then leaves the pipeline without
+// visiting later stages.
+struct Stage {
+    std::string name;
+    size_t workers;
     BoundedQueue<UploadItem> queue;
+    std::function<bool(UploadItem&)> fn;
+    Stage* next = nullptr;
+
     std::vector<std::thread> threads;
+    std::atomic<size_t> live{0};
+    std::atomic<size_t> busy{0};
+    std::atomic<uint64_t> processed{0};
+    std::atomic<uint64_t> service_ns{0};
+
+    Stage(std::string n, size_t w, size_t capacity, std::function<bool(UploadItem&)> f)
+    : name(std::move(n)), workers(w == 0 ? 1 : w), queue(capacity), fn(std::move(f)) {}
+};
+
+} // namespace
+
+struct WorkerPool::Impl {
+    std::vector<std::unique_ptr<Stage>> stages;
     std::atomic<bool> running;
-    std::string storage_dir;
+    std::mutex live_mtx;
+    std::condition_variable live_cv;
+    size_t live = 0;
+    bool abandoned = false;
+    ObjectStore& store;
     std::string preview_dir;
+    std::string hls_dir;
     NotifyFn notify;
-    sqlite3* db = nullptr;
+    DoneFn on_done;
+    Catalog catalog;
 
-    Impl(size_t cap, const std::string& sdir, const std::string& pdir, NotifyFn n)
-    : queue(cap), running(false), storage_dir(sdir), preview_dir(pdir), notify(n), db(nullptr) {
-        std::filesystem::create_directories(storage_dir);
+    Impl(ObjectStore& st, const std::string& pdir, const std::string& hdir, NotifyFn n, DoneFn d)
+    : running(false), store(st), preview_dir(pdir), hls_dir(hdir), notify(n), on_done(d),
+      catalog(st.root() + "/metadata.db", false) {
         std::filesystem::create_directories(preview_dir);
-        std::string dbfile = storage_dir + "/metadata.db";
-        if (sqlite3_open(dbfile.c_str(), &db) != SQLITE_OK) {
-            std::cerr << "Failed to open sqlite db: " << sqlite3_errmsg(db) << std::endl;
-            sqlite3_close(db);
-            db = nullptr;
-        } else {
-            const char* create_sql = "CREATE TABLE IF NOT EXISTS uploads (id INTEGER PRIMARY KEY, filename TEXT, checksum TEXT UNIQUE, path TEXT, preview TEXT, uploaded_at DATETIME DEFAULT CURRENT_TIMESTAMP);";
-            char* err = nullptr;
-            sqlite3_exec(db, create_sql, nullptr, nullptr, &err);
-            if (err) { std::cerr << "sqlite create table err: " << err << std::endl; sqlite3_free(err); }
-        }
+        if (!hls_dir.empty()) std::filesystem::create_directories(hls_dir);
     }
+};
 
-    ~Impl() {
-        if (db) sqlite3_close(db);
+static bool finalize_stage(WorkerPool::Impl* impl, UploadItem& item) {
+    // Journal replays of items finalized before a crash arrive with the
+    // object already in place and no staged file left to move.
+    if (item.stored_path.empty() || !impl->store.contains(item.checksum)) {
+        item.stored_path = impl->store.put(item.temp_path, item.checksum);
     }
-};
+    item.alias = impl->store.link_alias(item.checksum, item.filename);
+    return true;
+}
 
-static void process_item(WorkerPool::Impl* impl, UploadItem item) {
-    try {
-        std::string dest = impl->storage_dir + "/" + item.filename;
-        if (std::filesystem::exists(dest)) {
-            std::string alt = item.filename + "." + std::to_string(std::chrono::system_clock::now().time_since_epoch().count());
-            dest = impl->storage_dir + "/" + alt;
-        }
-        std::filesystem::rename(item.temp_path, dest);
+static bool probe_stage(WorkerPool::Impl*, UploadItem& item) {
+    std::error_code ec;
+    auto size = std::filesystem::file_size(item.stored_path, ec);
+    if (ec) {
+        std::cerr << "probe: cannot stat " << item.stored_path << ": " << ec.message() << std::endl;
+        return false;
+    }
+    if (item.filesize > 0 && static_cast<int64_t>(size) != item.filesize) {
+        std::cerr << "probe: " << item.filename << " is " << size << " bytes, producer declared " << item.filesize << std::endl;
+    }
+    item.filesize = static_cast<int64_t>(size);
 
-        std::string preview = impl->preview_dir + "/" + std::filesystem::path(dest).filename().string() + ".preview.mp4";
-        std::string cmd = "ffmpeg -y -hide_banner -loglevel error -i \""+dest+"\" -ss 0 -t 10 -c:v libx264 -preset veryfast -crf 28 -c:a aac -b:a 64k \""+preview+"\"";
-        int rc = std::system(cmd.c_str());
-        if (rc != 0) {
-            std::cerr << "ffmpeg preview generation failed rc=" << rc << std::endl;
-        }
+    // Unknown formats are still stored and cataloged, just without metadata.
+    std::string err;
+    if (!probe_media(item.stored_path, &item.media, &err)) {
+        std::cerr << "probe: " << item.filename << ": " << err << std::endl;
+    }
+    return true;
+}
 
-        if (impl->db) {
-            const char* insert_sql = "INSERT OR IGNORE INTO uploads(filename, checksum, path, preview) VALUES(?,?,?,?);";
-            sqlite3_stmt* stmt = nullptr;
-            if (sqlite3_prepare_v2(impl->db, insert_sql, -1, &stmt, nullptr) == SQLITE_OK) {
-                sqlite3_bind_text(stmt, 1, item.filename.c_str(), -1, SQLITE_TRANSIENT);
-                sqlite3_bind_text(stmt, 2, item.checksum.c_str(), -1, SQLITE_TRANSIENT);
-                sqlite3_bind_text(stmt, 3, dest.c_str(), -1, SQLITE_TRANSIENT);
-                sqlite3_bind_text(stmt, 4, preview.c_str(), -1, SQLITE_TRANSIENT);
-                sqlite3_step(stmt);
-                sqlite3_finalize(stmt);
-            }
-        }
+static bool preview_stage(WorkerPool::Impl* impl, UploadItem& item) {
+    item.preview_path = impl->preview_dir + "/" + item.checksum + ".preview.mp4";
+    std::string cmd = "ffmpeg -y -hide_banner -loglevel error -i \""+item.stored_path+"\" -ss 0 -t 10 -c:v libx264 -preset veryfast -crf 28 -c:a aac -b:a 64k \""+item.preview_path+"\"";
+    int rc = std::system(cmd.c_str());
+    if (rc != 0) {
+        std::cerr << "ffmpeg preview generation failed rc=" << rc << std::endl;
+    }
+    return true;
+}
+
+// Remuxes the upload into fMP4 HLS segments. Streams already in codecs every
+// HLS player handles are copied as they are; anything else is transcoded.
+// Output goes to a temporary directory renamed into place at the end, so the
+// playlist is never served half written.
+static bool package_stage(WorkerPool::Impl* impl, UploadItem& item) {
+    namespace fs = std::filesystem;
+    std::string out_dir = impl->hls_dir + "/" + item.checksum;
+    std::string playlist = out_dir + "/index.m3u8";
+    std::error_code ec;
+    if (fs::exists(playlist, ec)) {
+        // Same content was packaged before (e.g. a journal replay).
+        item.hls_playlist = playlist;
+        return true;
+    }
 
-        std::string preview_url = std::string("/previews/") + std::filesystem::path(preview).filename().string();
-        std::string final_url = std::string("/uploads/") + std::filesystem::path(dest).filename().string();
+    const MediaInfo& m = item.media;
+    std::string video_args = "-c:v libx264 -preset veryfast -crf 23 -g 48";
+    if (m.video_codec == "h264") video_args = "-c:v copy";
+    else if (m.video_codec == "hevc") video_args = "-c:v copy -tag:v hvc1";
+    std::string audio_args = m.audio_codec == "aac" ? "-c:a copy" : "-c:a aac -b:a 128k";
 
-        impl->notify(item, preview_url, final_url);
-    } catch (const std::exception& ex) {
-        std::cerr << "Exception in process_item: " << ex.what() << std::endl;
+    std::string tmp_dir = out_dir + ".tmp";
+    fs::remove_all(tmp_dir, ec);
+    fs::create_directories(tmp_dir, ec);
+    std::string cmd = "ffmpeg -y -hide_banner -loglevel error -i \""+item.stored_path+"\" -map 0:v:0? -map 0:a:0? "
+        + video_args + " " + audio_args
+        + " -f hls -hls_time 6 -hls_playlist_type vod -hls_segment_type fmp4 -hls_fmp4_init_filename init.mp4"
+        + " -hls_segment_filename \""+tmp_dir+"/seg_%05d.m4s\" \""+tmp_dir+"/index.m3u8\"";
+    int rc = std::system(cmd.c_str());
+    if (rc != 0) {
+        std::cerr << "ffmpeg HLS packaging failed rc=" << rc << " for " << item.filename << std::endl;
+        fs::remove_all(tmp_dir, ec);
+        return true;
+    }
+    fs::rename(tmp_dir, out_dir, ec);
+    if (ec) {
+        std::cerr << "HLS publish failed for " << item.filename << ": " << ec.message() << std::endl;
+        fs::remove_all(tmp_dir, ec);
+        return true;
     }
+    item.hls_playlist = playlist;
+    return true;
+}
+
+static bool catalog_stage(WorkerPool::Impl* impl, UploadItem& item) {
+    impl->catalog.insert(item);
+
+    std::string preview_url = std::string("/previews/") + std::filesystem::path(item.preview_path).filename().string();
+    std::string final_url = item.alias.empty()
+        ? std::string("/uploads/") + ObjectStore::object_url_path(item.checksum)
+        : std::string("/uploads/names/") + item.alias;
+
+    impl->notify(item, preview_url, final_url);
+    return true;
 }
 
-WorkerPool::WorkerPool(size_t workers, const std::string& storage_dir, const std::string& preview_dir, NotifyFn notify) {
-    impl = new Impl(workers * 4, storage_dir, preview_dir, notify);
-    (void)workers;
+WorkerPool::WorkerPool(const WorkerConfig& config, ObjectStore& store, const std::string& preview_dir, NotifyFn notify, DoneFn on_done) {
+    impl = new Impl(store, preview_dir, config.hls_dir, notify, on_done);
+    size_t cpu = config.cpu_workers;
+    if (cpu == 0) {
+        // Preview and package encodes share the cores, so together they do
+        // not run more ffmpeg processes than there are cores.
+        cpu = std::thread::hardware_concurrency();
+        if (cpu == 0) cpu = 2;
+        size_t package = config.package_workers == 0 ? 1 : config.package_workers;
+        if (!config.hls_dir.empty()) cpu = cpu > package ? cpu - package : 1;
+    }
+
+    Impl* p = impl;
+    auto add = [p](const char* name, size_t workers, size_t capacity, bool (*fn)(Impl*, UploadItem&)) {
+        p->stages.push_back(std::make_unique<Stage>(name, workers, capacity, [p, fn](UploadItem& item){ return fn(p, item); }));
+    };
+    add("finalize", config.io_workers, config.queue_capacity, finalize_stage);
+    add("probe", config.io_workers, config.stage_capacity, probe_stage);
+    add("preview", cpu, config.stage_capacity, preview_stage);
+    if (!config.hls_dir.empty()) add("package", config.package_workers, config.stage_capacity, package_stage);
+    // SQLite writes are serialized anyway; one thread avoids lock contention.
+    add("catalog", 1, config.stage_capacity, catalog_stage);
+    for (size_t i = 0; i + 1 < impl->stages.size(); ++i) {
+        impl->stages[i]->next = impl->stages[i + 1].get();
+    }
 }
 
 WorkerPool::~WorkerPool() {
     stop();
-    delete impl;
+    // Workers abandoned by a timed-out drain may still reference impl; the
+    // process is exiting in that case, so leak it rather than race them.
+    if (!impl->abandoned) delete impl;
+}
+
+static void run_stage(WorkerPool::Impl* impl, Stage* stage) {
+    const std::string wait_name = stage->name + ".wait";
+    while (auto item = stage->queue.pop_blocking()) {
+        if (!impl->running) break;
+        stage->busy++;
+        uint64_t started_us = 0;
+        if (item->trace.sampled) {
+            started_us = media::Tracer::now_us();
+            if (item->enqueued_us && started_us > item->enqueued_us) {
+                media::Tracer::record(item->trace, wait_name.c_str(), item->enqueued_us, started_us - item->enqueued_us);
+            }
+        }
+        auto t0 = std::chrono::steady_clock::now();
+        bool keep = false;
+        try {
+            keep = stage->fn(*item);
+        } catch (const std::exception& ex) {
+            std::cerr << "Exception in " << stage->name << " stage: " << ex.what() << std::endl;
+        }
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+        stage->service_ns += static_cast<uint64_t>(ns);
+        stage->processed++;
+        stage->busy--;
+        if (item->trace.sampled) {
+            media::Tracer::record(item->trace, stage->name.c_str(), started_us, static_cast<uint64_t>(ns) / 1000,
+                                  keep ? "" : "\"dropped\":true");
+            item->enqueued_us = started_us + static_cast<uint64_t>(ns) / 1000;
+        }
+
+        if (keep && stage->next) {
+            // Blocks while the next stage is full; fails only when abandoned.
+            stage->next->queue.push_blocking(std::move(*item));
+        } else if (keep) {
+            if (impl->on_done) impl->on_done(*item);
+        } else {
+            // Not reported as done: the journal keeps it (and its staged
+            // file) for a replay on the next start, and its checksum stays
+            // reserved for that replay.
+            std::cerr << stage->name << " failed for " << item->filename << "; left journaled for replay" << std::endl;
+        }
+    }
+
+    // The last thread out closes the next stage, so a drain cascades down
+    // the pipeline only after everything upstream has been handed over.
+    if (--stage->live == 0 && stage->next) stage->next->queue.close();
+    std::lock_guard<std::mutex> lk(impl->live_mtx);
+    --impl->live;
+    impl->live_cv.notify_all();
 }
 
 void WorkerPool::start() {
     if (impl->running.exchange(true)) return;
-    size_t num = std::thread::hardware_concurrency();
-    if (num == 0) num = 2;
-    for (size_t i=0;i<num;i++) {
-        impl->threads.emplace_back([this]{
-            while (impl->running) {
-                UploadItem item = impl->queue.pop_blocking();
-                process_item(impl, std::move(item));
-            }
-        });
+    for (auto& stage : impl->stages) {
+        stage->live = stage->workers;
+        impl->live += stage->workers;
+    }
+    for (auto& stage : impl->stages) {
+        for (size_t i = 0; i < stage->workers; ++i) {
+            stage->threads.emplace_back(run_stage, impl, stage.get());
+        }
     }
 }
 
-void WorkerPool::stop() {
+bool WorkerPool::stop(std::chrono::milliseconds drain_timeout) {
+    impl->stages.front()->queue.close();
+    if (impl->stages.front()->threads.empty()) return !impl->abandoned;
+
+    bool drained;
+    {
+        std::unique_lock<std::mutex> lk(impl->live_mtx);
+        drained = impl->live_cv.wait_for(lk, drain_timeout, [&]{ return impl->live == 0; });
+    }
     impl->running = false;
-    for (auto &t : impl->threads) {
-        if (t.joinable()) t.detach();
+    for (auto& stage : impl->stages) {
+        // Unblocks threads waiting to pop or to hand over to this stage.
+        stage->queue.close();
+    }
+    for (auto& stage : impl->stages) {
+        for (auto& t : stage->threads) {
+            if (!t.joinable()) continue;
+            if (drained) t.join();
+            else t.detach();
+        }
+        stage->threads.clear();
     }
-    impl->threads.clear();
+    if (!drained) {
+        impl->abandoned = true;
+        std::cerr << "Pipeline drain timed out; unfinished items stay journaled" << std::endl;
+    }
+    return drained;
+}
+
+bool WorkerPool::try_enqueue(UploadItem&& item) {
+    return impl->stages.front()->queue.try_push(std::move(item));
 }
 
-void WorkerPool::enqueue(UploadItem&& item) {
-    impl->queue.try_push(std::move(item));
-}
\ No newline at end of file
+bool WorkerPool::enqueue(UploadItem&& item) {
+    return impl->stages.front()->queue.push_blocking(std::move(item));
+}
+
+std::vector<StageStats> WorkerPool::stats() const {
+    std::vector<StageStats> out;
+    for (auto& stage : impl->stages) {
+        StageStats st;
+        st.name = stage->name;
+        st.workers = stage->workers;
+        st.queue_depth = stage->queue.size();
+        st.busy = stage->busy.load();
+        st.processed = stage->processed.load();
+        st.avg_service_ms = st.processed ? stage->service_ns.load() / 1e6 / st.processed : 0.0;
+        out.push_back(st);
+    }
+    return out;
+}
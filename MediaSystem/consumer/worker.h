@@ -1,30 +1,89 @@
 #pragma once
+#include "probe.h"
+#include "common/trace.h"
 #include <string>
 #include <thread>
 #include <atomic>
 #include <vector>
 #include <functional>
+#include <chrono>
+
+class ObjectStore;
 
 struct UploadItem {
     std::string temp_path;
     std::string filename;
     std::string producer_id;
     std::string checksum;
+    std::string hash_algorithm;
     int64_t filesize;
+
+    // Filled in as the item moves through the pipeline stages.
+    std::string stored_path;
+    std::string alias;
+    std::string preview_path;
+    MediaInfo media;
+    std::string hls_playlist;   // <hls_dir>/<checksum>/index.m3u8, empty if not packaged
+
+    // Tracing; enqueued_us is when the item entered its current stage's queue.
+    media::TraceContext trace;
+    uint64_t enqueued_us = 0;
 };
 
 using NotifyFn = std::function<void(const UploadItem&, const std::string& preview_url, const std::string& final_url)>;
+// Called once per item that made it through every stage. Items a stage
+// failed on (threw or returned false) are not reported, so a caller that
+// journals them replays them on the next start.
+using DoneFn = std::function<void(const UploadItem&)>;
+
+// Thread and queue sizing for the ingest pipeline, plus optional stages.
+struct WorkerConfig {
+    size_t queue_capacity = 8;   // uploads waiting to be finalized; beyond this producers get "queue full"
+    size_t stage_capacity = 8;   // hand-off queue in front of every later stage
+    size_t io_workers = 2;       // finalize + probe (filesystem bound)
+    size_t cpu_workers = 0;      // preview encoding (CPU bound); 0 = one per core, minus package_workers
+    size_t package_workers = 1;  // HLS packaging (CPU bound when transcoding); only with hls_dir
+    std::string hls_dir;         // HLS packaging output; empty leaves the package stage out
+};
+
+struct StageStats {
+    std::string name;
+    size_t workers;
+    size_t queue_depth;
+    size_t busy;
+    uint64_t processed;
+    double avg_service_ms;
+};
 
+// Staged ingest pipeline:
+//
+//   finalize -> probe -> preview -> [package] -> catalog
+//
+// Every stage has its own bounded queue and thread pool, so slow ffmpeg
+// runs never hold up file moves and SQLite writes stay on a single thread.
+// A full downstream queue blocks the stage in front of it (backpressure)
+// until it reaches the admission queue, where uploads are then refused.
 class WorkerPool {
 public:
-    WorkerPool(size_t workers, const std::string& storage_dir, const std::string& preview_dir, NotifyFn notify);
+    WorkerPool(const WorkerConfig& config, ObjectStore& store, const std::string& preview_dir, NotifyFn notify, DoneFn on_done = nullptr);
     ~WorkerPool();
 
     void start();
-    void stop();
-    void enqueue(UploadItem&& item);
+    // Stops accepting work and lets the stages finish what is queued. Items
+    // still unfinished after drain_timeout are abandoned; their threads keep
+    // running detached. Stages are idempotent, so a caller that journals
+    // items can replay them on the next start, whether or not they had
+    // already been finalized. Returns false in that case: the detached
+    // threads still use the store, the callbacks and whatever they capture,
+    // so the caller must not destroy any of it (the consumer exits at once).
+    bool stop(std::chrono::milliseconds drain_timeout = std::chrono::milliseconds(0));
+    // Admission without waiting; false if the first stage is full or stopped.
+    bool try_enqueue(UploadItem&& item);
+    // Blocks while the first stage is full; returns false once stop() was called.
+    bool enqueue(UploadItem&& item);
+
+    std::vector<StageStats> stats() const;
 
-    // expose the queue so the gRPC service can try_push into it
-    class Impl;
+    struct Impl;
     Impl* impl;
 };
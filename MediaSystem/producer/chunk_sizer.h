@@ -0,0 +1,52 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+
+// Picks the upload chunk size from measured throughput.
+//
+// Hill climbing over powers of two between MIN_CHUNK and MAX_CHUNK: after
+// each measurement window the size keeps moving in the same direction while
+// throughput improves by more than 5%, turns around when it drops by more
+// than 5%, and holds on a plateau. Small chunks suit high-RTT links that
+// stall on flow control; large ones cut per-message overhead on fast links.
+class ChunkSizer {
+public:
+    static constexpr size_t MIN_CHUNK = 64 * 1024;
+    // Stays well under gRPC's default 4 MB receive limit with framing, so
+    // consumers that never raised the limit accept every chunk.
+    static constexpr size_t MAX_CHUNK = 2 * 1024 * 1024;
+
+    size_t next_size() const { return size_; }
+
+    // Reports one chunk of `bytes` that took `elapsed` to hand to the transport.
+    void record(size_t bytes, std::chrono::steady_clock::duration elapsed) {
+        window_bytes_ += bytes;
+        window_time_ += elapsed;
+        ++window_chunks_;
+        if (window_chunks_ < 8 || window_time_ < std::chrono::milliseconds(50)) return;
+
+        double secs = std::chrono::duration<double>(window_time_).count();
+        double rate = secs > 0 ? window_bytes_ / secs : 0;
+        window_bytes_ = 0;
+        window_time_ = std::chrono::steady_clock::duration::zero();
+        window_chunks_ = 0;
+
+        if (last_rate_ > 0) {
+            if (rate < last_rate_ * 0.95) growing_ = !growing_;
+            else if (rate < last_rate_ * 1.05) { last_rate_ = rate; return; }
+        }
+        last_rate_ = rate;
+        size_ = growing_ ? std::min(size_ * 2, MAX_CHUNK) : std::max(size_ / 2, MIN_CHUNK);
+    }
+
+    double last_rate_bytes_per_sec() const { return last_rate_; }
+
+private:
+    size_t size_ = MIN_CHUNK;
+    bool growing_ = true;
+    double last_rate_ = 0;
+    size_t window_bytes_ = 0;
+    size_t window_chunks_ = 0;
+    std::chrono::steady_clock::duration window_time_{};
+};
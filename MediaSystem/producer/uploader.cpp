@@ -1,48 +1,22 @@
 #include "uploader.h"
 #include "media.grpc.pb.h"
 #include "media.pb.h"
+#include "common/hash.h"
+#include "common/trace.h"
+#include "chunk_sizer.h"
 
-#include <openssl/sha.h>
 #include <fstream>
 #include <iostream>
 #include <vector>
 #include <filesystem>
+#include <algorithm>
+#include <chrono>
+#include <google/protobuf/arena.h>
 
 namespace fs = std::filesystem;
 
-static std::string sha256_of_file(const std::string& path)
-{
-    std::ifstream file(path, std::ios::binary);
-    if (!file)
-        throw std::runtime_error("Unable to open file for hashing: " + path);
-
-    SHA256_CTX ctx;
-    SHA256_Init(&ctx);
-
-    std::vector<unsigned char> buffer(8192);
-    while (file.good())
-    {
-        file.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
-        SHA256_Update(&ctx, buffer.data(), file.gcount());
-    }
-
-    unsigned char hash[SHA256_DIGEST_LENGTH];
-    SHA256_Final(hash, &ctx);
-
-    std::string hex;
-    hex.reserve(64);
-    static const char* digits = "0123456789abcdef";
-
-    for (int i = 0; i < SHA256_DIGEST_LENGTH; i++)
-    {
-        hex.push_back(digits[(hash[i] >> 4) & 0xF]);
-        hex.push_back(digits[hash[i] & 0xF]);
-    }
-
-    return hex;
-}
-
-Uploader::Uploader(const std::string& server)
+Uploader::Uploader(const std::string& server, media::HashAlgorithm algo)
+: algo_(algo)
 {
     channel_ = grpc::CreateChannel(server, grpc::InsecureChannelCredentials());
     stub_ = media::MediaUpload::NewStub(channel_);
@@ -57,8 +31,19 @@ bool Uploader::upload_file(const std::string& filepath, const std::string& produ
         return false;
     }
 
+    media::TraceContext trace = media::Tracer::start_trace();
+    media::Span upload_span(trace, "producer.upload");
+    upload_span.set_args(media::Tracer::arg("file", fs::path(filepath).filename().string()));
+
     auto filesize = fs::file_size(filepath);
-    auto hash = sha256_of_file(filepath);
+    media::Span hash_span(trace, "producer.hash");
+    auto hash = media::hash_file(filepath, algo_);
+    hash_span.end();
+    if (hash.empty())
+    {
+        std::cerr << "[Producer] Unable to hash file: " << filepath << "\n";
+        return false;
+    }
 
     std::ifstream file(filepath, std::ios::binary);
     if (!file)
@@ -68,39 +53,58 @@ bool Uploader::upload_file(const std::string& filepath, const std::string& produ
     }
 
     grpc::ClientContext ctx;
+    // Sent even when unsampled so the consumer follows our decision.
+    if (trace.valid()) ctx.AddMetadata("traceparent", trace.traceparent());
+    media::Span transfer_span(trace, "producer.transfer");
     media::UploadStatus response;
     auto writer = stub_->Upload(&ctx, &response);
 
-    media::UploadRequest req;
-    media::FileInfo* info = req.mutable_info();
+    // One arena per upload owns the request messages. A single Chunk is
+    // attached to the chunk request for each Write and released afterwards,
+    // so its data buffer is allocated once and the file is read straight
+    // into it.
+    google::protobuf::Arena arena;
+    auto* req = google::protobuf::Arena::CreateMessage<media::UploadRequest>(&arena);
+    media::FileInfo* info = req->mutable_info();
 
     info->set_filename(fs::path(filepath).filename().string());
     info->set_producer_id(producer_id);
     info->set_filesize((int64_t)filesize);
     info->set_mime("application/octet-stream"); 
+    info->set_hash_algorithm(media::hash_algorithm_name(algo_));
+    info->set_checksum(hash);
 
-    writer->Write(req);
+    writer->Write(*req);
     int64_t offset = 0;
 
-    std::vector<char> buffer(64 * 1024);
+    auto* chunk_req = google::protobuf::Arena::CreateMessage<media::UploadRequest>(&arena);
+    auto* chunk = google::protobuf::Arena::CreateMessage<media::Chunk>(&arena);
+    std::string* data = chunk->mutable_data();
+    ChunkSizer sizer;
 
-    while (!file.eof())
+    while (file)
     {
-        file.read(buffer.data(), buffer.size());
+        size_t want = sizer.next_size();
+        if (data->capacity() < want) data->reserve(std::min<size_t>(ChunkSizer::MAX_CHUNK, std::max<size_t>(want, filesize)));
+        data->resize(want);
+        file.read(&(*data)[0], want);
         std::streamsize bytes_read = file.gcount();
         if (bytes_read <= 0) break;
 
-       media::UploadRequest req;
-        media::Chunk* c = req.mutable_chunk();
-        c->set_data(buffer.data(), (size_t)bytes_read);
-        c->set_offset(offset);
-        writer->Write(req);
+        data->resize((size_t)bytes_read);
+        chunk->set_offset(offset);
+        auto t0 = std::chrono::steady_clock::now();
+        chunk_req->unsafe_arena_set_allocated_chunk(chunk);
+        bool ok = writer->Write(*chunk_req);
+        chunk_req->unsafe_arena_release_chunk();
+        if (!ok) break;
+        sizer.record((size_t)bytes_read, std::chrono::steady_clock::now() - t0);
         offset += bytes_read;
-
     }
 
     writer->WritesDone();
     grpc::Status status = writer->Finish();
+    transfer_span.end();
 
     if (!status.ok())
     {
@@ -108,6 +112,7 @@ bool Uploader::upload_file(const std::string& filepath, const std::string& produ
         return false;
     }
 
-    std::cout << "[Producer] Upload result: " << response.message() << "\n";
+    std::cout << "[Producer] Upload result: " << response.message()
+              << " (final chunk size " << sizer.next_size() / 1024 << " KB)\n";
     return true;
 }
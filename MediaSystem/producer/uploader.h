@@ -2,17 +2,20 @@
 
 #include <grpcpp/grpcpp.h>
 #include "media.grpc.pb.h"
+#include "common/hash.h"
 #include <memory>
 #include <string>
 
 class Uploader {
 public:
-    explicit Uploader(const std::string& server_address);
+    explicit Uploader(const std::string& server_address,
+                      media::HashAlgorithm algo = media::HashAlgorithm::Sha256);
 
     bool upload_file(const std::string& filepath, const std::string& producer_id);
 
 private:
     std::shared_ptr<grpc::Channel> channel_;
     std::unique_ptr<media::MediaUpload::Stub> stub_;
+    media::HashAlgorithm algo_;
 
 };
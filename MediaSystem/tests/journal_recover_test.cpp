@@ -0,0 +1,153 @@
+// Crash/recover test for the work journal: uploads accepted before a crash
+// must all reach the catalog after a restart, including ones the finalize
+// stage had already moved into the object store. An upload a stage fails on
+// must stay journaled, with its staged file, instead of being marked done.
+
+#include "consumer/catalog.h"
+#include "consumer/journal.h"
+#include "consumer/object_store.h"
+#include "consumer/worker.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace fs = std::filesystem;
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK failed: " #cond << std::endl; \
+            ++failures; \
+        } \
+    } while (0)
+
+static UploadItem stage_upload(ObjectStore& store, const std::string& name, char fill) {
+    UploadItem item;
+    item.temp_path = store.new_staging_path();
+    item.filename = name;
+    item.producer_id = "test";
+    item.checksum = std::string(64, fill);
+    item.hash_algorithm = "sha256";
+    item.filesize = 4;
+    std::ofstream(item.temp_path, std::ios::binary) << "data";
+    return item;
+}
+
+int main() {
+    fs::path root = fs::temp_directory_path() / "media_journal_recover_test";
+    fs::remove_all(root);
+    fs::create_directories(root);
+    std::string journal_path = (root / ".journal").string();
+
+    // First run: four uploads accepted and journaled, then a crash.
+    {
+        ObjectStore store(root.string());
+        WorkJournal journal(journal_path);
+        CHECK(journal.recover(store).empty());
+
+        UploadItem finalized = stage_upload(store, "finalized.mp4", 'a');
+        UploadItem staged = stage_upload(store, "staged.mp4", 'b');
+        UploadItem done = stage_upload(store, "done.mp4", 'c');
+        UploadItem lost = stage_upload(store, "lost.mp4", 'd');
+        for (const auto* item : {&finalized, &staged, &done, &lost}) journal.append_accepted(*item);
+
+        // finalize ran for the first item, so its staged file is gone.
+        store.put(finalized.temp_path, finalized.checksum);
+        CHECK(!fs::exists(finalized.temp_path));
+        // The third completed; the fourth lost its staged file and never
+        // reached the store.
+        store.put(done.temp_path, done.checksum);
+        journal.mark_done(done.temp_path);
+        fs::remove(lost.temp_path);
+    }
+
+    // Restart: both unfinished uploads with data must come back.
+    {
+        ObjectStore store(root.string());
+        WorkJournal journal(journal_path);
+        auto items = journal.recover(store);
+        CHECK(items.size() == 2);
+        for (const auto& item : items) {
+            if (item.filename == "finalized.mp4") {
+                CHECK(item.stored_path == store.object_path(item.checksum));
+            } else {
+                CHECK(item.filename == "staged.mp4");
+                CHECK(item.stored_path.empty());
+                CHECK(fs::exists(item.temp_path));
+            }
+        }
+
+        WorkerConfig config;
+        config.cpu_workers = 1;
+        WorkerPool pool(config, store, (root / "previews").string(),
+                        [](const UploadItem&, const std::string&, const std::string&) {},
+                        [&journal](const UploadItem& item) { journal.mark_done(item.temp_path); });
+        pool.start();
+        for (auto& item : items) CHECK(pool.enqueue(std::move(item)));
+        pool.stop(std::chrono::seconds(60));
+
+        CHECK(store.contains(std::string(64, 'a')));
+        CHECK(store.contains(std::string(64, 'b')));
+    }
+
+    // Both are cataloged and nothing is left to replay.
+    {
+        Catalog catalog((root / "metadata.db").string(), true);
+        CatalogQuery query;
+        query.sort = "name";
+        query.descending = false;
+        CatalogPage page;
+        std::string err;
+        CHECK(catalog.search(query, &page, &err));
+        CHECK(page.rows.size() == 2);
+        if (page.rows.size() == 2) {
+            CHECK(page.rows[0].filename == "finalized.mp4");
+            CHECK(page.rows[1].filename == "staged.mp4");
+        }
+
+        ObjectStore store(root.string());
+        WorkJournal journal(journal_path);
+        CHECK(journal.recover(store).empty());
+    }
+
+    // A malformed checksum makes finalize throw.
+    std::string bad_temp;
+    {
+        ObjectStore store(root.string());
+        WorkJournal journal(journal_path);
+        CHECK(journal.recover(store).empty());
+        UploadItem bad = stage_upload(store, "bad.mp4", 'e');
+        bad.checksum = "not-a-checksum";
+        bad_temp = bad.temp_path;
+        journal.append_accepted(bad);
+
+        WorkerConfig config;
+        config.cpu_workers = 1;
+        WorkerPool pool(config, store, (root / "previews").string(),
+                        [](const UploadItem&, const std::string&, const std::string&) {},
+                        [&journal](const UploadItem& item) { journal.mark_done(item.temp_path); });
+        pool.start();
+        CHECK(pool.enqueue(std::move(bad)));
+        pool.stop(std::chrono::seconds(60));
+        CHECK(fs::exists(bad_temp));
+    }
+    {
+        ObjectStore store(root.string());
+        WorkJournal journal(journal_path);
+        auto items = journal.recover(store);
+        CHECK(items.size() == 1);
+        if (items.size() == 1) CHECK(items[0].temp_path == bad_temp);
+    }
+
+    fs::remove_all(root);
+    if (failures) {
+        std::cerr << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "journal_recover_test passed" << std::endl;
+    return 0;
+}